@@ -1,7 +1,12 @@
 #include <stdio.h>
 
+#include <algorithm>
+
 #include "AgentDirectory.h"
 #include "ai/SoldierAgent.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "Replay.h"
 
 namespace Brigades {
 
@@ -10,6 +15,7 @@ bool AgentDirectory::addAgent(const SoldierPtr s, boost::shared_ptr<SoldierContr
 	auto sold = mAgents.find(s);
 	if(sold == mAgents.end()) {
 		mAgents.insert({s, {c, a}});
+		mUpdateOrderDirty = true;
 		return true;
 	} else {
 		return false;
@@ -23,6 +29,7 @@ bool AgentDirectory::freeSoldier(const SoldierPtr s)
 		return false;
 
 	mAgents.erase(pair);
+	mUpdateOrderDirty = true;
 	return true;
 }
 
@@ -34,6 +41,7 @@ bool AgentDirectory::removeAgent(const SoldierPtr s, boost::shared_ptr<SoldierAg
 
 	if(pair->second.second == a) {
 		mAgents.erase(pair);
+		mUpdateOrderDirty = true;
 		return true;
 	}
 
@@ -45,6 +53,87 @@ std::map<SoldierPtr, std::pair<boost::shared_ptr<SoldierController>, boost::shar
 	return mAgents;
 }
 
+void AgentDirectory::updateOrder()
+{
+	mUpdateOrder.clear();
+	for(auto& p : mAgents) {
+		UpdateEntry e;
+		e.soldier = p.first;
+		e.controller = p.second.first;
+		e.agent = p.second.second;
+		mUpdateOrder.push_back(e);
+	}
+
+	std::sort(mUpdateOrder.begin(), mUpdateOrder.end(),
+			[] (const UpdateEntry& e1, const UpdateEntry& e2) {
+			return e1.soldier->getID() < e2.soldier->getID();
+			});
+	mUpdateOrderDirty = false;
+}
+
+// The agents decide their actions in parallel, all seeing the world as
+// it was at the start of the update. The actions are then executed one
+// soldier at a time in the order of soldier IDs, so the outcome doesn't
+// depend on the number of threads.
+void AgentDirectory::update(float time)
+{
+	ProfileScope profile(ProfileSection::Agents);
+
+	if(mUpdateOrderDirty)
+		updateOrder();
+
+	// add comms from the controllers to the agents
+	for(auto& e : mUpdateOrder) {
+		auto comms = e.controller->fetchCommunications();
+		for(auto& c : comms) {
+			e.agent->newCommunication(c);
+		}
+	}
+
+	// update controllers and get actions from the agents
+	ThreadPool::getInstance()->parallelFor(mUpdateOrder.size(), [&] (unsigned int i) {
+		UpdateEntry& e = mUpdateOrder[i];
+		e.controller->update(time);
+		e.actions = e.agent->update(time);
+	});
+
+	// execute actions
+	if(mRecorder)
+		mRecorder->startTick(time);
+
+	for(auto& e : mUpdateOrder) {
+		if(mRecorder && !e.actions.empty())
+			mRecorder->addActions(e.soldier->getID(), e.actions);
+
+		for(auto& a : e.actions) {
+			bool succ = a.execute(e.soldier, e.controller, time);
+			if(!succ) {
+				fprintf(stderr, "Error: action %d failed.\n", (int)a.getType());
+				assert(0);
+			}
+		}
+		e.actions.clear();
+	}
+
+	if(mRecorder)
+		mRecorder->endTick();
+}
+
+void AgentDirectory::updateControllers(float time)
+{
+	if(mUpdateOrderDirty)
+		updateOrder();
+
+	// the agents aren't run, so their comms are dropped
+	for(auto& e : mUpdateOrder) {
+		e.controller->fetchCommunications();
+	}
+
+	ThreadPool::getInstance()->parallelFor(mUpdateOrder.size(), [&] (unsigned int i) {
+		mUpdateOrder[i].controller->update(time);
+	});
+}
+
 void AgentDirectory::soldierAdded(SoldierPtr p)
 {
 	auto controller = SoldierControllerPtr(new SoldierController(p));
@@ -52,6 +141,7 @@ void AgentDirectory::soldierAdded(SoldierPtr p)
 	auto pair = mAgents.find(p);
 	assert(pair == mAgents.end());
 	mAgents.insert({p, {controller, a}});
+	mUpdateOrderDirty = true;
 }
 
 void AgentDirectory::soldierRemoved(SoldierPtr p)
@@ -59,6 +149,7 @@ void AgentDirectory::soldierRemoved(SoldierPtr p)
 	auto pair = mAgents.find(p);
 	assert(pair != mAgents.end());
 	mAgents.erase(pair);
+	mUpdateOrderDirty = true;
 }
 
 boost::shared_ptr<SoldierController> AgentDirectory::getControllerFor(const boost::shared_ptr<Soldier> s)
@@ -70,6 +161,11 @@ boost::shared_ptr<SoldierController> AgentDirectory::getControllerFor(const boos
 		return pair->second.first;
 }
 
+void AgentDirectory::setReplayRecorder(ReplayRecorder* recorder)
+{
+	mRecorder = recorder;
+}
+
 
 }
 
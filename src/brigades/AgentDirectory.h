@@ -2,14 +2,17 @@
 #define BRIGADES_AGENTDIRECTORY_H
 
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "World.h"
 #include "Soldier.h"
 #include "SoldierController.h"
+#include "SoldierAction.h"
 
 namespace Brigades {
 
 class SoldierAgent;
+class ReplayRecorder;
 
 class AgentDirectory : public SoldierListener {
 	public:
@@ -17,13 +20,39 @@ class AgentDirectory : public SoldierListener {
 		bool freeSoldier(const SoldierPtr s);
 		bool removeAgent(const SoldierPtr s, boost::shared_ptr<SoldierAgent> a);
 		std::map<SoldierPtr, std::pair<boost::shared_ptr<SoldierController>, boost::shared_ptr<SoldierAgent>>>& getAgents();
+		void update(float time);
+		// updates only the controllers; the actions come from a replay.
+		void updateControllers(float time);
 		virtual void soldierAdded(SoldierPtr p) override;
 		virtual void soldierRemoved(SoldierPtr p) override;
 
 		boost::shared_ptr<SoldierController> getControllerFor(const boost::shared_ptr<Soldier> s);
+		void setReplayRecorder(ReplayRecorder* recorder);
 
 	private:
+		friend class boost::serialization::access;
+		// only the state of the AI agents is saved. The soldiers must
+		// have been loaded from the same archive before.
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
+		struct UpdateEntry {
+			SoldierPtr soldier;
+			boost::shared_ptr<SoldierController> controller;
+			boost::shared_ptr<SoldierAgent> agent;
+			std::vector<SoldierAction> actions;
+		};
+
+		void updateOrder();
+
 		std::map<SoldierPtr, std::pair<boost::shared_ptr<SoldierController>, boost::shared_ptr<SoldierAgent>>> mAgents;
+
+		// the agents sorted by soldier ID, rebuilt when agents are
+		// added or removed.
+		std::vector<UpdateEntry> mUpdateOrder;
+		bool mUpdateOrderDirty = true;
+
+		ReplayRecorder* mRecorder = nullptr;
 };
 
 }
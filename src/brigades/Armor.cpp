@@ -16,15 +16,39 @@ Armor::Armor(int sidenum)
 	mRotation = 0.1f;
 }
 
+// for loading saved games
+Armor::Armor()
+	: Common::Vehicle(0.5f, 10.0f, 100.0f),
+	mID(0),
+	mSide(0),
+	mRoadCheck(0.5f)
+{
+	mRadius = 3.5f;
+	mMaxSpeed = 30.0f;
+	mMaxAcceleration = 10.0f;
+	mRotation = 0.1f;
+}
+
 int Armor::getSideNum() const
 {
 	return mSide;
 }
 
+static int LastArmorID = 0;
+
 int Armor::getNextID()
 {
-	static int id = 0;
-	return ++id;
+	return ++LastArmorID;
+}
+
+int Armor::getLastID()
+{
+	return LastArmorID;
+}
+
+void Armor::setLastID(int id)
+{
+	LastArmorID = id;
 }
 
 bool Armor::isDestroyed() const
@@ -2,6 +2,7 @@
 #define BRIGADES_ARMOR_H
 
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/Vehicle.h"
 
@@ -26,7 +27,16 @@ class Armor : public Common::Vehicle {
 		int freePassengerSeats() const;
 		bool roadCheck(float time);
 
+		// the ID of the latest armor, for saved games
+		static int getLastID();
+		static void setLastID(int id);
+
 	private:
+		friend class boost::serialization::access;
+		Armor();
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		static int getNextID();
 
 		int mID;
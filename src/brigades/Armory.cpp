@@ -63,7 +63,7 @@ float WeaponType::getDamageAgainstHeavyArmor() const
 
 const char* WeaponType::getName() const
 {
-	return mName;
+	return mName.c_str();
 }
 
 bool WeaponType::speedVariates() const
@@ -200,6 +200,46 @@ void Armory::setInstance(Armory* a)
 	mInstance = a;
 }
 
+SimulationArmory::SimulationArmory()
+{
+	mAssaultRifle = boost::shared_ptr<WeaponType>(new WeaponType("Assault Rifle",
+				170.0f, 200.0f, 0.1f,
+				Math::degreesToRadians(1.0f), true));
+	mMachineGun = boost::shared_ptr<WeaponType>(new WeaponType("Machine Gun",
+				180.0f, 200.0f, 0.04f,
+				Math::degreesToRadians(2.0f), true));
+	mBazooka = boost::shared_ptr<WeaponType>(new WeaponType("Bazooka",
+				150.0f, 160.0f, 4.0f,
+				Math::degreesToRadians(0.5f), true,
+				1.0f, 1.0f, 1.0f));
+	mPistol = boost::shared_ptr<WeaponType>(new WeaponType("Pistol",
+				100.0f, 180.0f, 0.5f,
+				Math::degreesToRadians(2.0f), true));
+	mAutoCannon = boost::shared_ptr<WeaponType>(new WeaponType("Automatic Cannon",
+				200.0f, 200.0f, 0.25f,
+				Math::degreesToRadians(1.0f), false, 1.0f, 1.0f, 0.0f));
+}
+
+ArcadeArmory::ArcadeArmory()
+{
+	mAssaultRifle = boost::shared_ptr<WeaponType>(new WeaponType("Assault Rifle",
+				25.0f, 20.0f, 0.1f,
+				Math::degreesToRadians(5.0f), false));
+	mMachineGun = boost::shared_ptr<WeaponType>(new WeaponType("Machine Gun",
+				35.0f, 20.0f, 0.04f,
+				Math::degreesToRadians(5.0f), false));
+	mBazooka = boost::shared_ptr<WeaponType>(new WeaponType("Bazooka",
+				30.0f, 16.0f, 4.0f,
+				Math::degreesToRadians(5.0f), false,
+				1.0f, 1.0f, 1.0f));
+	mPistol = boost::shared_ptr<WeaponType>(new WeaponType("Pistol",
+				15.0f, 18.0f, 0.5f,
+				Math::degreesToRadians(5.0f), false));
+	mAutoCannon = boost::shared_ptr<WeaponType>(new WeaponType("Automatic Cannon",
+				40.0f, 20.0f, 0.25f,
+				Math::degreesToRadians(5.0f), false, 1.0f, 1.0f, 0.0f));
+}
+
 }
 
 
@@ -1,8 +1,11 @@
 #ifndef BRIGADES_ARMORY_H
 #define BRIGADES_ARMORY_H
 
+#include <string>
+
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/Vector3.h"
 #include "common/Clock.h"
@@ -34,7 +37,7 @@ class WeaponType {
 		bool speedVariates() const;
 
 	protected:
-		const char* mName;
+		std::string mName;
 		float mRange;
 		float mVelocity;
 		float mLoadTime;
@@ -43,6 +46,12 @@ class WeaponType {
 		float mSoftDamage;
 		float mLightArmorDamage;
 		float mHeavyArmorDamage;
+
+	private:
+		friend class boost::serialization::access;
+		WeaponType() { }
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
 };
 
 class Weapon : public boost::enable_shared_from_this<Weapon> {
@@ -67,6 +76,12 @@ class Weapon : public boost::enable_shared_from_this<Weapon> {
 	protected:
 		boost::shared_ptr<WeaponType> mWeapon;
 		Common::Countdown mLoading;
+
+	private:
+		friend class boost::serialization::access;
+		Weapon() { }
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
 };
 
 typedef boost::shared_ptr<Weapon> WeaponPtr;
@@ -123,6 +138,16 @@ class AutomaticCannon : public Weapon {
 		const char* getName() const;
 };
 
+class ArcadeArmory : public Armory {
+	public:
+		ArcadeArmory();
+};
+
+class SimulationArmory : public Armory {
+	public:
+		SimulationArmory();
+};
+
 }
 
 #endif
@@ -0,0 +1,645 @@
+#include <iostream>
+#include <sstream>
+#include <functional>
+#include <map>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common/Clock.h"
+#include "common/Random.h"
+#include "common/Math.h"
+
+#include "Benchmarks.h"
+#include "Scenario.h"
+#include "World.h"
+#include "Terrain.h"
+#include "SlotMap.h"
+#include "AgentDirectory.h"
+#include "SoldierAction.h"
+#include "Savegame.h"
+#include "ThreadPool.h"
+#include "SensorySystem.h"
+
+using namespace Common;
+
+namespace Brigades {
+
+namespace Benchmarks {
+
+static std::vector<SoldierPtr> getAllSoldiers(WorldPtr world)
+{
+	return world->getSoldiersAt(Vector3(0.0f, 0.0f, 0.0f),
+			std::max(world->getWidth(), world->getHeight()));
+}
+
+// every armed soldier fires a machine gun burst in a random direction
+// every 40 ms; only the world update is timed.
+static void bullets(int seed)
+{
+	static const float timestep = 0.02f;
+	static const unsigned int numTicks = 500;
+
+	Scenario scenario(false, false);
+	srand(seed);
+	WorldPtr world = scenario.createWorld(seed);
+	world->create();
+
+	std::vector<SoldierPtr> shooters;
+	for(auto s : getAllSoldiers(world)) {
+		if(s->getCurrentWeapon())
+			shooters.push_back(s);
+	}
+
+	unsigned long bulletUpdates = 0;
+	double updateTime = 0.0;
+	for(unsigned int i = 0; i < numTicks; i++) {
+		if(i % 2 == 0) {
+			for(auto s : shooters) {
+				if(s->isDead())
+					continue;
+				Vector3 dir = Math::rotate2D(Vector3(1.0f, 0.0f, 0.0f), Random::uniform() * TWO_PI);
+				world->addBullet(s->getCurrentWeapon(), s, dir);
+			}
+		}
+
+		bulletUpdates += world->getNumBullets();
+		double start = Clock::getTime();
+		world->update(timestep);
+		updateTime += Clock::getTime() - start;
+	}
+
+	std::cout << "Shooters: " << shooters.size() << "\n";
+	std::cout << "Bullet updates: " << bulletUpdates << "\n";
+	std::cout << "Update time: " << updateTime * 1000.0 << " ms\n";
+	std::cout << "Bullets per millisecond: " << bulletUpdates / (updateTime * 1000.0) << "\n";
+}
+
+// line of sight from random observers to random points within 200 meters,
+// with the trees near the observer tested one by one and with the
+// occlusion map of the terrain.
+static void occlusion(int seed)
+{
+	static const unsigned int numObservers = 1000;
+	static const unsigned int numTargets = 100;
+	static const float distance = 200.0f;
+
+	srand(seed);
+	Terrain terrain(1536, 1536, seed);
+
+	std::vector<Vector3> observers;
+	std::vector<Vector3> targets;
+	for(unsigned int i = 0; i < numObservers; i++) {
+		Vector3 pos(Random::clamped() * 700.0f, Random::clamped() * 700.0f, 0.0f);
+		observers.push_back(pos);
+		for(unsigned int j = 0; j < numTargets; j++) {
+			targets.push_back(pos + Math::rotate2D(Vector3(Random::uniform() * distance, 0.0f, 0.0f),
+						Random::uniform() * TWO_PI));
+		}
+	}
+
+	double queryTime = 0.0;
+	double start = Clock::getTime();
+	std::vector<bool> treeResults;
+	for(unsigned int i = 0; i < numObservers; i++) {
+		double qstart = Clock::getTime();
+		auto trees = terrain.getTreesAt(observers[i], distance);
+		queryTime += Clock::getTime() - qstart;
+
+		for(unsigned int j = 0; j < numTargets; j++) {
+			const Vector3& tgt = targets[i * numTargets + j];
+			bool blocked = false;
+			for(auto t : trees) {
+				if(Math::segmentCircleIntersect(observers[i], tgt,
+							t->getPosition(), t->getRadius())) {
+					blocked = true;
+					break;
+				}
+			}
+			treeResults.push_back(blocked);
+		}
+	}
+	double treeTime = Clock::getTime() - start;
+
+	start = Clock::getTime();
+	std::vector<bool> mapResults;
+	for(unsigned int i = 0; i < numObservers; i++) {
+		for(unsigned int j = 0; j < numTargets; j++) {
+			mapResults.push_back(terrain.lineBlocked(observers[i], targets[i * numTargets + j]));
+		}
+	}
+	double mapTime = Clock::getTime() - start;
+
+	unsigned int numLines = numObservers * numTargets;
+	unsigned int same = 0;
+	unsigned int blocked = 0;
+	for(unsigned int i = 0; i < numLines; i++) {
+		if(treeResults[i] == mapResults[i])
+			same++;
+		if(treeResults[i])
+			blocked++;
+	}
+
+	std::cout << "Lines: " << numLines << " (" << blocked << " blocked by trees)\n";
+	std::cout << "Tree list: " << treeTime * 1000.0 << " ms, of which tree queries "
+		<< queryTime * 1000.0 << " ms; "
+		<< numLines / ((treeTime - queryTime) * 1000.0) << " lines per millisecond without the queries\n";
+	std::cout << "Occlusion map: " << mapTime * 1000.0 << " ms; "
+		<< numLines / (mapTime * 1000.0) << " lines per millisecond\n";
+	std::cout << "Same result: " << same * 100.0 / numLines << "%\n";
+}
+
+// the per-tick walk over all soldiers of a company battle, as done by
+// World::update, with the soldiers in a map iterated by value and in a
+// slot map iterated by reference.
+static void storage(int seed)
+{
+	static const unsigned int numTicks = 20000;
+
+	Scenario scenario(false, false);
+	srand(seed);
+	WorldPtr world = scenario.createWorld(seed);
+	world->create();
+
+	std::map<int, SoldierPtr> soldierMap;
+	SlotMap<SoldierPtr> soldierSlots;
+	auto soldiers = getAllSoldiers(world);
+	std::sort(soldiers.begin(), soldiers.end(),
+			[] (const SoldierPtr& s1, const SoldierPtr& s2) { return s1->getID() < s2->getID(); });
+	for(auto s : soldiers) {
+		soldierMap.insert(std::make_pair(s->getID(), s));
+		soldierSlots.insert(s->getID(), s);
+	}
+
+	float mapSum = 0.0f;
+	double start = Clock::getTime();
+	for(unsigned int i = 0; i < numTicks; i++) {
+		for(auto sit : soldierMap) {
+			auto s = sit.second;
+			if(!s->isDead())
+				mapSum += s->getPosition().x;
+		}
+	}
+	double mapTime = Clock::getTime() - start;
+
+	float slotSum = 0.0f;
+	start = Clock::getTime();
+	for(unsigned int i = 0; i < numTicks; i++) {
+		for(auto& s : soldierSlots) {
+			if(!s->isDead())
+				slotSum += s->getPosition().x;
+		}
+	}
+	double slotTime = Clock::getTime() - start;
+
+	std::cout << "Soldiers: " << soldiers.size() << "\n";
+	std::cout << "Map: " << mapTime * 1000.0 << " ms; "
+		<< mapTime * 1000000000.0 / numTicks << " ns per tick\n";
+	std::cout << "Slot map: " << slotTime * 1000.0 << " ms; "
+		<< slotTime * 1000000000.0 / numTicks << " ns per tick\n";
+	std::cout << "Same result: " << (mapSum == slotSum ? "yes" : "no") << "\n";
+}
+
+// both sides of a company battle armed with machine guns, firing at the
+// enemy home base as fast as the guns load. The enemy is out of range,
+// so nobody dies, but every burst is heard by most of the shooter's own
+// side.
+static void mgduel(int seed)
+{
+	static const float timestep = 0.02f;
+	static const unsigned int numTicks = 1000;
+
+	Scenario scenario(false, false);
+	srand(seed);
+	WorldPtr world = scenario.createWorld(seed);
+	world->create();
+
+	auto gunners = getAllSoldiers(world);
+	for(auto s : gunners) {
+		s->clearWeapons();
+		s->addWeapon(world->getArmory().getMachineGun());
+		s->switchWeapon(0);
+	}
+
+	unsigned long shots = 0;
+	double updateTime = 0.0;
+	for(unsigned int i = 0; i < numTicks; i++) {
+		double start = Clock::getTime();
+		for(auto s : gunners) {
+			auto w = s->getCurrentWeapon();
+			if(s->isDead() || !w->canShoot())
+				continue;
+			Vector3 dir = world->getHomeBasePosition(s->getSideNum() != 0) - s->getPosition();
+			w->shoot(world, s, dir);
+			shots++;
+		}
+
+		world->update(timestep);
+		updateTime += Clock::getTime() - start;
+	}
+
+	std::cout << "Gunners: " << gunners.size() << "\n";
+	std::cout << "Shots: " << shots << "\n";
+	std::cout << "Time: " << updateTime * 1000.0 << " ms; "
+		<< updateTime * 1000.0 / numTicks << " ms per tick\n";
+}
+
+// saves and loads a company battle in memory after the agents have run
+// for a while and both sides have fired at each other's home base, so
+// that there are bullets and events in flight. The timers may lose some
+// precision when first loaded, but after that loading a saved game and
+// saving it again must give the same bytes.
+static void savegame(int seed)
+{
+	static const float timestep = 0.02f;
+	static const unsigned int numTicks = 500;
+	static const unsigned int numRounds = 10;
+
+	Scenario scenario(false, false);
+	srand(seed);
+	WorldPtr world = scenario.createWorld(seed);
+	AgentDirectory agents;
+	world->setSoldierListener(&agents);
+	SoldierAction::setAgentDirectory(&agents);
+	world->create();
+
+	auto gunners = getAllSoldiers(world);
+	for(unsigned int i = 0; i < numTicks; i++) {
+		for(auto s : gunners) {
+			auto w = s->getCurrentWeapon();
+			if(s->isDead() || !w || !w->canShoot())
+				continue;
+			Vector3 dir = world->getHomeBasePosition(s->getSideNum() != 0) - s->getPosition();
+			w->shoot(world, s, dir);
+		}
+		world->update(timestep);
+		agents.update(timestep);
+	}
+
+	std::string data;
+	double saveTime = 0.0;
+	for(unsigned int i = 0; i < numRounds; i++) {
+		std::ostringstream os;
+		double start = Clock::getTime();
+		Savegame::save(os, scenario, *world, agents);
+		saveTime += Clock::getTime() - start;
+		data = os.str();
+	}
+
+	auto reload = [&] (const std::string& saved) {
+		std::istringstream is(saved);
+		AgentDirectory loadedAgents;
+		bool arcade, skirmish;
+		int mapSize;
+		Savegame::readHeader(is, arcade, skirmish, mapSize);
+		WorldPtr loaded = Savegame::load(is, scenario, loadedAgents);
+		std::ostringstream os;
+		Savegame::save(os, scenario, *loaded, loadedAgents);
+		return os.str();
+	};
+
+	double loadTime = 0.0;
+	for(unsigned int i = 0; i < numRounds; i++) {
+		std::istringstream is(data);
+		AgentDirectory loadedAgents;
+		bool arcade, skirmish;
+		int mapSize;
+		double start = Clock::getTime();
+		Savegame::readHeader(is, arcade, skirmish, mapSize);
+		Savegame::load(is, scenario, loadedAgents);
+		loadTime += Clock::getTime() - start;
+	}
+
+	std::string resaved = reload(data);
+
+	world->setSoldierListener(nullptr);
+	SoldierAction::setAgentDirectory(nullptr);
+
+	std::cout << "Soldiers: " << getAllSoldiers(world).size() << "\n";
+	std::cout << "Bullets: " << world->getNumBullets() << "\n";
+	std::cout << "Size: " << data.size() / 1024 << " KiB\n";
+	std::cout << "Save: " << saveTime * 1000.0 / numRounds << " ms\n";
+	std::cout << "Load: " << loadTime * 1000.0 / numRounds << " ms\n";
+	std::cout << "Saved again after loading: " << (reload(resaved) == resaved ? "identical" : "DIFFERENT") << "\n";
+}
+
+// generates a large terrain with the cache in a temporary directory and
+// then loads it from the cache. The loaded trees must be the same and in
+// the same order.
+static void terrain(int seed)
+{
+	char dir[] = "/tmp/brigades-terrain-XXXXXX";
+	if(!mkdtemp(dir)) {
+		std::cerr << "Could not create a temporary directory.\n";
+		return;
+	}
+	std::string olddir = Terrain::getCacheDirectory();
+	Terrain::setCacheDirectory(dir);
+
+	double start = Clock::getTime();
+	Terrain generated(1536, 1536, seed);
+	double generateTime = Clock::getTime() - start;
+
+	start = Clock::getTime();
+	Terrain loaded(1536, 1536, seed);
+	double loadTime = Clock::getTime() - start;
+
+	auto all = Vector3(0.0f, 0.0f, 0.0f);
+	auto trees1 = generated.getTreesAt(all, 1536.0f);
+	auto trees2 = loaded.getTreesAt(all, 1536.0f);
+	bool same = trees1.size() == trees2.size() &&
+		generated.getRoadsAt(all, 1536.0f).size() == loaded.getRoadsAt(all, 1536.0f).size();
+	for(unsigned int i = 0; same && i < trees1.size(); i++) {
+		same = trees1[i]->getPosition() == trees2[i]->getPosition() &&
+			trees1[i]->getRadius() == trees2[i]->getRadius();
+	}
+
+	remove(generated.getCacheFilename().c_str());
+	rmdir(dir);
+	Terrain::setCacheDirectory(olddir);
+
+	std::cout << "Trees: " << trees1.size() << "\n";
+	std::cout << "Generate: " << generateTime * 1000.0 << " ms\n";
+	std::cout << "Load from cache: " << loadTime * 1000.0 << " ms\n";
+	std::cout << "Loaded terrain: " << (same ? "identical" : "DIFFERENT") << "\n";
+}
+
+// generates the terrain of a 4096x4096 map without the cache. The time
+// spent on the roads is printed while generating.
+static void roads(int seed)
+{
+	std::string olddir = Terrain::getCacheDirectory();
+	Terrain::setCacheDirectory("");
+
+	double start = Clock::getTime();
+	Terrain terrain(4096, 4096, seed);
+	double generateTime = Clock::getTime() - start;
+
+	Terrain::setCacheDirectory(olddir);
+
+	auto roads = terrain.getRoadsAt(Vector3(0.0f, 0.0f, 0.0f), 4096.0f);
+	float length = 0.0f;
+	for(auto r : roads)
+		length += r->getStart().distance(r->getEnd());
+
+	std::cout << "Road segments: " << roads.size() << "\n";
+	std::cout << "Road length: " << length / 1000.0f << " km\n";
+	std::cout << "Terrain generation: " << generateTime * 1000.0 << " ms\n";
+}
+
+// generates the terrain of a 4096x4096 map with different numbers of
+// threads. The trees must be the same every time.
+static void terraingen(int seed)
+{
+	static const unsigned int threadCounts[] = { 1, 2, 4, 8 };
+
+	std::string olddir = Terrain::getCacheDirectory();
+	Terrain::setCacheDirectory("");
+	auto oldpool = ThreadPool::getInstance();
+
+	std::vector<Vector3> first;
+	bool same = true;
+	for(auto n : threadCounts) {
+		ThreadPool::setInstance(boost::shared_ptr<ThreadPool>(new ThreadPool(n)));
+		double start = Clock::getTime();
+		Terrain terrain(4096, 4096, seed);
+		double generateTime = Clock::getTime() - start;
+
+		std::vector<Vector3> trees;
+		for(auto t : terrain.getTreesAt(Vector3(0.0f, 0.0f, 0.0f), 4096.0f)) {
+			trees.push_back(Vector3(t->getPosition().x, t->getPosition().y, t->getRadius()));
+		}
+		if(first.empty())
+			first = trees;
+		else
+			same = same && trees == first;
+
+		std::cout << "Threads: " << n << "; terrain generation: " << generateTime * 1000.0 << " ms\n";
+	}
+
+	ThreadPool::setInstance(oldpool);
+	Terrain::setCacheDirectory(olddir);
+
+	std::cout << "Trees: " << first.size() << "\n";
+	std::cout << "Terrain with different numbers of threads: " << (same ? "identical" : "DIFFERENT") << "\n";
+}
+
+// moves a company-sized group of positions across a 16x16 km streamed
+// terrain, updating the regions every 20 meters as the world would every
+// second, and back again. The trees must be the same when coming back.
+static void streaming(int seed)
+{
+	static const float mapSize = 16384.0f;
+	static const float radius = 264.0f;
+	static const float step = 20.0f;
+	static const float distance = 4000.0f;
+
+	double start = Clock::getTime();
+	Terrain terrain(mapSize, mapSize, seed, TerrainMode::Streamed);
+	double createTime = Clock::getTime() - start;
+
+	Vector3 origin(-distance * 0.5f, -distance * 0.5f, 0.0f);
+	auto positionsAt = [&] (float d) {
+		std::vector<Vector3> positions;
+		for(int i = 0; i < 100; i++) {
+			positions.push_back(origin + Vector3(d + (i % 10) * 10.0f, d + (i / 10) * 10.0f, 0.0f));
+		}
+		return positions;
+	};
+	auto treesAround = [&] () {
+		std::vector<Vector3> trees;
+		for(auto t : terrain.getTreesAt(origin, radius)) {
+			trees.push_back(Vector3(t->getPosition().x, t->getPosition().y, t->getRadius()));
+		}
+		std::sort(trees.begin(), trees.end());
+		return trees;
+	};
+
+	terrain.updateRegions(positionsAt(0.0f), radius);
+	auto before = treesAround();
+
+	unsigned int updates = 0;
+	unsigned int maxRegions = 0;
+	double updateTime = 0.0;
+	double maxUpdateTime = 0.0;
+	auto moveTo = [&] (float d) {
+		auto positions = positionsAt(d);
+		double t = Clock::getTime();
+		terrain.updateRegions(positions, radius);
+		t = Clock::getTime() - t;
+		updateTime += t;
+		maxUpdateTime = std::max(maxUpdateTime, t);
+		maxRegions = std::max(maxRegions, terrain.getNumRegions());
+		updates++;
+	};
+	for(float d = step; d <= distance; d += step)
+		moveTo(d);
+	for(float d = distance - step; d >= 0.0f; d -= step)
+		moveTo(d);
+
+	bool same = treesAround() == before;
+
+	std::cout << "Map: " << mapSize / 1000.0f << " km\n";
+	std::cout << "Creation: " << createTime * 1000.0 << " ms\n";
+	std::cout << "Updates: " << updates << "\n";
+	std::cout << "Update: " << updateTime * 1000.0 / updates << " ms on average, "
+		<< maxUpdateTime * 1000.0 << " ms at most\n";
+	std::cout << "Active squares: " << maxRegions << " at most\n";
+	std::cout << "Trees when coming back: " << (same ? "identical" : "DIFFERENT") << "\n";
+}
+
+// a company battle where both sides fire at each other's home base, so
+// that the soldiers keep hearing each other. After every update the
+// known enemies and the position of every unit are asked for as the
+// tactical map does, and compared with computing them from scratch.
+static void units(int seed)
+{
+	static const float timestep = 0.02f;
+	static const unsigned int numTicks = 1000;
+
+	Scenario scenario(false, false);
+	srand(seed);
+	WorldPtr world = scenario.createWorld(seed);
+	AgentDirectory agents;
+	world->setSoldierListener(&agents);
+	SoldierAction::setAgentDirectory(&agents);
+	world->create();
+
+	std::function<void (const Soldier&, std::set<SoldierPtr>&)> knownEnemies =
+		[&] (const Soldier& s, std::set<SoldierPtr>& known) {
+			auto seen = s.getSensorySystem()->getSoldiers();
+			known.insert(seen.begin(), seen.end());
+			for(auto& c : s.getCommandees())
+				knownEnemies(*c, known);
+		};
+	std::function<Vector3 (const Soldier&)> unitPosition = [&] (const Soldier& s) {
+		if(s.getCommandees().empty())
+			return s.getPosition();
+		Vector3 midp;
+		for(auto& c : s.getCommandees())
+			midp += unitPosition(*c);
+		return midp / s.getCommandees().size();
+	};
+
+	auto gunners = getAllSoldiers(world);
+	unsigned long queries = 0;
+	unsigned long mismatches = 0;
+	double cachedTime = 0.0;
+	double scratchTime = 0.0;
+	for(unsigned int i = 0; i < numTicks; i++) {
+		for(auto s : gunners) {
+			auto w = s->getCurrentWeapon();
+			if(s->isDead() || !w || !w->canShoot())
+				continue;
+			Vector3 dir = world->getHomeBasePosition(s->getSideNum() != 0) - s->getPosition();
+			w->shoot(world, s, dir);
+		}
+		world->update(timestep);
+		agents.update(timestep);
+
+		std::vector<SoldierPtr> leaders;
+		for(auto s : getAllSoldiers(world)) {
+			if(!s->getCommandees().empty())
+				leaders.push_back(s);
+		}
+
+		std::vector<std::pair<Vector3, unsigned int>> cached;
+		double start = Clock::getTime();
+		for(auto l : leaders) {
+			cached.push_back(std::make_pair(l->getUnitPosition(),
+						(unsigned int)l->getKnownEnemySoldiers().size()));
+		}
+		cachedTime += Clock::getTime() - start;
+
+		for(unsigned int j = 0; j < leaders.size(); j++) {
+			start = Clock::getTime();
+			std::set<SoldierPtr> known;
+			knownEnemies(*leaders[j], known);
+			Vector3 pos = unitPosition(*leaders[j]);
+			scratchTime += Clock::getTime() - start;
+
+			if(known != leaders[j]->getKnownEnemySoldiers() ||
+					known.size() != cached[j].second ||
+					pos.distance2(cached[j].first) > 0.0001f)
+				mismatches++;
+		}
+		queries += leaders.size();
+	}
+
+	// the known enemies and unit positions aren't saved but rebuilt
+	// when loading
+	auto knownIDs = [] (const Soldier& s) {
+		std::vector<int> ids;
+		for(auto& e : s.getKnownEnemySoldiers())
+			ids.push_back(e->getID());
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	};
+	std::stringstream saved;
+	Savegame::save(saved, scenario, *world, agents);
+	AgentDirectory loadedAgents;
+	bool arcade, skirmish;
+	int mapSize;
+	Savegame::readHeader(saved, arcade, skirmish, mapSize);
+	WorldPtr loaded = Savegame::load(saved, scenario, loadedAgents);
+	bool sameLoaded = true;
+	for(auto s : getAllSoldiers(world)) {
+		auto l = loaded->getSoldier(s->getID());
+		if(!l || knownIDs(*l) != knownIDs(*s) ||
+				l->getUnitPosition().distance2(s->getUnitPosition()) > 0.0001f)
+			sameLoaded = false;
+	}
+
+	world->setSoldierListener(nullptr);
+	SoldierAction::setAgentDirectory(nullptr);
+
+	std::cout << "Unit queries: " << queries << "\n";
+	std::cout << "Cached: " << cachedTime * 1000.0 << " ms; "
+		<< cachedTime * 1000000.0 / numTicks << " us per tick\n";
+	std::cout << "From scratch: " << scratchTime * 1000.0 << " ms; "
+		<< scratchTime * 1000000.0 / numTicks << " us per tick\n";
+	std::cout << "Same result: " << (mismatches == 0 ? "yes" : "no") << "\n";
+	std::cout << "Same after loading: " << (sameLoaded ? "yes" : "no") << "\n";
+}
+
+static const struct {
+	const char* name;
+	std::function<void (int)> func;
+} benchmarks[] = {
+	{ "bullets", bullets },
+	{ "occlusion", occlusion },
+	{ "storage", storage },
+	{ "mgduel", mgduel },
+	{ "savegame", savegame },
+	{ "terrain", terrain },
+	{ "roads", roads },
+	{ "terraingen", terraingen },
+	{ "streaming", streaming },
+	{ "units", units },
+};
+
+bool run(const char* name, int seed)
+{
+	for(auto& b : benchmarks) {
+		if(!strcmp(b.name, name)) {
+			b.func(seed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void printNames()
+{
+	for(auto& b : benchmarks) {
+		std::cerr << b.name << " ";
+	}
+	std::cerr << "\n";
+}
+
+}
+
+}
+
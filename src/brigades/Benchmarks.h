@@ -0,0 +1,18 @@
+#ifndef BRIGADES_BENCHMARKS_H
+#define BRIGADES_BENCHMARKS_H
+
+namespace Brigades {
+
+// micro-benchmarks for the simulation, run by the headless binary.
+namespace Benchmarks {
+
+// returns false if there is no benchmark with the given name.
+bool run(const char* name, int seed);
+void printNames();
+
+}
+
+}
+
+#endif
+
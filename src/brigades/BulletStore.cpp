@@ -0,0 +1,155 @@
+#include <cassert>
+
+#include "BulletStore.h"
+#include "Armory.h"
+
+using namespace Common;
+
+namespace Brigades {
+
+// bullets move up to 16 meters per tick
+static const float gridCellSize = 32.0f;
+
+BulletStore::BulletStore(float width, float height)
+	: mSize(0),
+	mGrid(width, height, gridCellSize)
+{
+}
+
+unsigned int BulletStore::add(const WeaponPtr w, int shooterSide,
+		const Vector3& pos, const Vector3& vel, float timeleft)
+{
+	unsigned int i = mSize++;
+	if(i == mPositions.size()) {
+		mPositions.push_back(pos);
+		mVelocities.push_back(vel);
+		mTimeLeft.push_back(timeleft);
+		mFlyTime.push_back(0.0f);
+		mShooterSides.push_back(shooterSide);
+		mOriginalSpeeds.push_back(w->getVelocity());
+		mWeapons.push_back(w);
+		mObstacleCaches.push_back(std::vector<Tree*>());
+	} else {
+		mPositions[i] = pos;
+		mVelocities[i] = vel;
+		mTimeLeft[i] = timeleft;
+		mFlyTime[i] = 0.0f;
+		mShooterSides[i] = shooterSide;
+		mOriginalSpeeds[i] = w->getVelocity();
+		mWeapons[i] = w;
+		mObstacleCaches[i].clear();
+	}
+	mGrid.add(i, pos);
+	return i;
+}
+
+void BulletStore::remove(unsigned int i)
+{
+	assert(i < mSize);
+	unsigned int last = --mSize;
+	bool found = mGrid.remove(i, mPositions[i]);
+	assert(found);
+	if(i != last) {
+		found = mGrid.replace(last, i, mPositions[last]);
+		assert(found);
+		mPositions[i] = mPositions[last];
+		mVelocities[i] = mVelocities[last];
+		mTimeLeft[i] = mTimeLeft[last];
+		mFlyTime[i] = mFlyTime[last];
+		mShooterSides[i] = mShooterSides[last];
+		mOriginalSpeeds[i] = mOriginalSpeeds[last];
+		mWeapons[i].swap(mWeapons[last]);
+		// swap to keep the allocated capacity of both caches
+		mObstacleCaches[i].swap(mObstacleCaches[last]);
+	}
+	mWeapons[last].reset();
+}
+
+unsigned int BulletStore::size() const
+{
+	return mSize;
+}
+
+Vector3& BulletStore::getPosition(unsigned int i)
+{
+	return mPositions[i];
+}
+
+const Vector3& BulletStore::getPosition(unsigned int i) const
+{
+	return mPositions[i];
+}
+
+Vector3& BulletStore::getVelocity(unsigned int i)
+{
+	return mVelocities[i];
+}
+
+const Vector3& BulletStore::getVelocity(unsigned int i) const
+{
+	return mVelocities[i];
+}
+
+const WeaponPtr& BulletStore::getWeapon(unsigned int i) const
+{
+	return mWeapons[i];
+}
+
+int BulletStore::getShooterSide(unsigned int i) const
+{
+	return mShooterSides[i];
+}
+
+float BulletStore::getOriginalSpeed(unsigned int i) const
+{
+	return mOriginalSpeeds[i];
+}
+
+float BulletStore::getFlyTime(unsigned int i) const
+{
+	return mFlyTime[i];
+}
+
+float BulletStore::getTimeLeft(unsigned int i) const
+{
+	return mTimeLeft[i];
+}
+
+std::vector<Tree*>& BulletStore::getObstacleCache(unsigned int i)
+{
+	return mObstacleCaches[i];
+}
+
+bool BulletStore::update(unsigned int i, float time)
+{
+	Vector3 oldpos = mPositions[i];
+	mPositions[i] += mVelocities[i] * time;
+	mGrid.update(i, oldpos, mPositions[i]);
+	mFlyTime[i] += time;
+	mTimeLeft[i] -= time;
+	return mTimeLeft[i] > 0.0f;
+}
+
+BulletQuery::BulletQuery(const BulletStore& store, unsigned int i)
+	: mStore(store),
+	mIndex(i)
+{
+}
+
+const Vector3& BulletQuery::getPosition() const
+{
+	return mStore.getPosition(mIndex);
+}
+
+const Vector3& BulletQuery::getVelocity() const
+{
+	return mStore.getVelocity(mIndex);
+}
+
+const WeaponPtr& BulletQuery::getWeapon() const
+{
+	return mStore.getWeapon(mIndex);
+}
+
+}
+
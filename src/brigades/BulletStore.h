@@ -0,0 +1,97 @@
+#ifndef BRIGADES_BULLETSTORE_H
+#define BRIGADES_BULLETSTORE_H
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
+
+#include "common/Vector3.h"
+
+#include "SpatialGrid.h"
+
+namespace Brigades {
+
+class Tree;
+class Weapon;
+class BulletStore;
+
+typedef boost::shared_ptr<Weapon> WeaponPtr;
+
+// Bullets in flight, stored as parallel arrays. Removing a bullet moves
+// the last bullet in its place, so indices are only valid until the next
+// removal. Slots are reused, so after the first few bursts adding bullets
+// doesn't allocate. The bullets are also kept in a grid for area queries.
+class BulletStore {
+	public:
+		BulletStore(float width, float height);
+		// returns the index of the new bullet. The obstacle cache of the
+		// bullet is empty and can be filled by the caller.
+		unsigned int add(const WeaponPtr w, int shooterSide,
+				const Common::Vector3& pos, const Common::Vector3& vel, float timeleft);
+		void remove(unsigned int i);
+		unsigned int size() const;
+
+		Common::Vector3& getPosition(unsigned int i);
+		const Common::Vector3& getPosition(unsigned int i) const;
+		Common::Vector3& getVelocity(unsigned int i);
+		const Common::Vector3& getVelocity(unsigned int i) const;
+		const WeaponPtr& getWeapon(unsigned int i) const;
+		int getShooterSide(unsigned int i) const;
+		float getOriginalSpeed(unsigned int i) const;
+		float getFlyTime(unsigned int i) const;
+		float getTimeLeft(unsigned int i) const;
+		std::vector<Tree*>& getObstacleCache(unsigned int i);
+
+		// moves the bullet and returns false if its time ran out.
+		bool update(unsigned int i, float time);
+
+		// calls f(i) for the index of every bullet within the radius.
+		template<typename F>
+		void query(const Common::Vector3& pos, float radius, F f) const;
+
+	private:
+		friend class boost::serialization::access;
+		// the obstacle caches are not saved and need to be rebuilt
+		// after loading.
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
+		unsigned int mSize;
+		std::vector<Common::Vector3> mPositions;
+		std::vector<Common::Vector3> mVelocities;
+		std::vector<float> mTimeLeft;
+		std::vector<float> mFlyTime;
+		std::vector<int> mShooterSides;
+		std::vector<float> mOriginalSpeeds;
+		std::vector<WeaponPtr> mWeapons;
+		std::vector<std::vector<Tree*>> mObstacleCaches;
+		SpatialGrid<unsigned int> mGrid;
+};
+
+template<typename F>
+void BulletStore::query(const Common::Vector3& pos, float radius, F f) const
+{
+	float r2 = radius * radius;
+	mGrid.queryCircle(pos, radius, [&] (unsigned int i) {
+			if(mPositions[i].distance2(pos) <= r2)
+				f(i);
+			});
+}
+
+class BulletQuery {
+	public:
+		BulletQuery(const BulletStore& store, unsigned int i);
+		const Common::Vector3& getPosition() const;
+		const Common::Vector3& getVelocity() const;
+		const WeaponPtr& getWeapon() const;
+
+	private:
+		const BulletStore& mStore;
+		unsigned int mIndex;
+};
+
+}
+
+#endif
+
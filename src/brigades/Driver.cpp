@@ -4,10 +4,14 @@
 #include "Driver.h"
 #include "SensorySystem.h"
 #include "InputState.h"
+#include "Replay.h"
+#include "Profiler.h"
+#include "SpriteBatch.h"
+#include "StaticGeometry.h"
+#include "TextRenderer.h"
 
 #include "ai/SoldierAgent.h"
 
-#include "common/Random.h"
 #include "common/Rectangle.h"
 #include "common/SDL_utils.h"
 
@@ -17,6 +21,11 @@ namespace Brigades {
 
 static int screenWidth = 800;
 static int screenHeight = 600;
+// the size of the tree sprites relative to their radius
+static const float treeScale = 3.0f;
+
+// maximum wall-clock time spent on simulation ticks per frame
+static const double maxTickTimePerFrame = 0.05;
 
 bool Sprite::operator<(const Sprite& s1) const
 {
@@ -38,7 +47,7 @@ bool SpeechBubble::expired(float t)
 	return mTime.check();
 }
 
-Driver::Driver(WorldPtr w, bool observer, SoldierRank r)
+Driver::Driver(WorldPtr w, bool observer, SoldierRank r, float tickrate)
 	: mWorld(w),
 	mPaused(false),
 	mScaleLevel(7.5f),
@@ -52,6 +61,9 @@ Driver::Driver(WorldPtr w, bool observer, SoldierRank r)
 	mInputState(new InputState()),
 	mCreatingAttackOrder(false),
 	mTimeAcceleration(1.0f),
+	mTickTime(tickrate > 0.0f ? 1.0f / tickrate : 0.0f),
+	mTickAccumulator(0.0),
+	mInterpolation(1.0f),
 	mMapLevel(MapLevel::Normal)
 {
 	mWorld->setSoldierListener(&mAgentDirectory);
@@ -62,6 +74,22 @@ Driver::Driver(WorldPtr w, bool observer, SoldierRank r)
 	loadTextures();
 	loadFont();
 	SDL_utils::setupOrthoScreen(screenWidth, screenHeight);
+
+	mSpriteBatch = boost::shared_ptr<SpriteBatch>(new SpriteBatch());
+	for(int j = 0; j < NUM_SIDES; j++) {
+		for(int k = 0; k < 4; k++)
+			mSpriteBatch->addToAtlas(*mSoldierTexture[j][k]);
+		mSpriteBatch->addToAtlas(*mFallenSoldierTexture[j]);
+	}
+	for(auto t : { mSoldierShadowTexture, mTreeTexture, mFoxholeTexture,
+			mBrightSpot, mUnitIconShadowTexture })
+		mSpriteBatch->addToAtlas(*t);
+	for(auto t : mWeaponPickupTextures)
+		mSpriteBatch->addToAtlas(*t);
+
+	mStaticGeometry = boost::shared_ptr<StaticGeometry>(new StaticGeometry(mWorld,
+				mTreeShadowTexture.get(), mRoadTexture.get(), treeScale));
+	mTextRenderer = boost::shared_ptr<TextRenderer>(new TextRenderer(mFont, mSpriteBatch));
 }
 
 Driver::~Driver()
@@ -84,32 +112,6 @@ void Driver::init()
 	assert(mFocusSoldier);
 }
 
-void Driver::updateAgents(float time)
-{
-	for(auto& p : mAgentDirectory.getAgents()) {
-		// update controller
-		p.second.first->update(time);
-
-		// add comms from the controller to the agent
-		auto comms = p.second.first->fetchCommunications();
-		for(auto& c : comms) {
-			p.second.second->newCommunication(c);
-		}
-
-		// get actions from the agent
-		auto actions = p.second.second->update(time);
-
-		// execute actions
-		for(auto& a : actions) {
-			bool succ = a.execute(p.first, p.second.first, time);
-			if(!succ) {
-				fprintf(stderr, "Error: action %d failed.\n", (int)a.getType());
-				assert(0);
-			}
-		}
-	}
-}
-
 void Driver::applyPendingActions()
 {
 	if(!mFocusSoldier)
@@ -126,6 +128,9 @@ void Driver::applyPendingActions()
 
 	auto controller = it->second.first;
 
+	if(mRecorder)
+		mRecorder->addPlayerActions(mFocusSoldier->getID(), mPendingActions);
+
 	for(auto& a : mPendingActions) {
 		bool succ = a.execute(mFocusSoldier, controller, 0.0f);
 		if(!succ) {
@@ -135,10 +140,21 @@ void Driver::applyPendingActions()
 	mPendingActions.clear();
 }
 
+void Driver::setReplayRecorder(ReplayRecorder* recorder)
+{
+	mRecorder = recorder;
+	mAgentDirectory.setReplayRecorder(recorder);
+}
+
 void Driver::run()
 {
 	double prevTime = Clock::getTime();
 	while(1) {
+		// the previous frame was recorded at the end of its scope
+		if(Profiler::getInstance())
+			Profiler::getInstance()->endFrame();
+		ProfileScope profile(ProfileSection::Frame);
+
 		double newTime = Clock::getTime();
 		double frameTime = newTime - prevTime;
 		prevTime = newTime;
@@ -147,16 +163,10 @@ void Driver::run()
 		if(!mPaused && frameTime) {
 			applyPendingActions();
 
-			float ta = mTimeAcceleration;
-			while(ta >= 1.0f) {
-				mWorld->update(frameTime);
-				updateAgents(frameTime);
-				ta--;
-			}
-			if(ta > 0.0f) {
-				mWorld->update(ta * frameTime);
-				updateAgents(ta * frameTime);
-			}
+			if(mTickTime > 0.0f)
+				updateFixedStep(frameTime);
+			else
+				updateVariableStep(frameTime);
 		}
 
 		{
@@ -192,6 +202,47 @@ void Driver::run()
 	}
 }
 
+void Driver::updateFixedStep(double frameTime)
+{
+	mTickAccumulator += frameTime * mTimeAcceleration;
+
+	double deadline = Clock::getTime() + maxTickTimePerFrame;
+	while(mTickAccumulator >= mTickTime) {
+		mWorld->update(mTickTime);
+		mAgentDirectory.update(mTickTime);
+		mTickAccumulator -= mTickTime;
+
+		if(Clock::getTime() > deadline) {
+			// can't keep up - drop the backlog instead of stalling the renderer
+			mTickAccumulator = fmod(mTickAccumulator, mTickTime);
+			break;
+		}
+	}
+
+	mInterpolation = mTickAccumulator / mTickTime;
+}
+
+void Driver::updateVariableStep(double frameTime)
+{
+	float ta = mTimeAcceleration;
+	while(ta >= 1.0f) {
+		mWorld->update(frameTime);
+		mAgentDirectory.update(frameTime);
+		ta--;
+	}
+	if(ta > 0.0f) {
+		mWorld->update(ta * frameTime);
+		mAgentDirectory.update(ta * frameTime);
+	}
+}
+
+Vector3 Driver::interpolatedPosition(const Vector3& pos, const Vector3& vel) const
+{
+	// the previous tick's position is approximated by stepping back
+	// along the velocity, so no per-entity history is needed.
+	return pos - vel * ((1.0f - mInterpolation) * mTickTime);
+}
+
 #if 0
 bool Driver::handleAttackOrder(const AttackOrder& r)
 {
@@ -541,6 +592,13 @@ bool Driver::handleInput(float frameTime)
 						}
 						break;
 
+					case SDLK_F9:
+						// the profiler is started on the first use
+						if(!Profiler::getInstance())
+							Profiler::setInstance(boost::shared_ptr<Profiler>(new Profiler()));
+						mShowProfiler = !mShowProfiler;
+						break;
+
 					case SDLK_F1:
 					case SDLK_F2:
 					case SDLK_F3:
@@ -707,7 +765,7 @@ void Driver::handleInputState(float frameTime)
 				mFreeCamera = true;
 			}
 		}
-		mCamera = mSoldier->getPosition() + mCameraMouseOffset;
+		mCamera = interpolatedPosition(mSoldier->getPosition(), mSoldier->getVelocity()) + mCameraMouseOffset;
 		static const float scalechangevelocity = 0.9f;
 		static const float scalecoefficient = 1.5f;
 		float n;
@@ -757,6 +815,8 @@ Common::Vector3 Driver::terrainPositionToScreenPosition(const Common::Vector3& p
 
 void Driver::drawTerrain()
 {
+	ProfileScope profile(ProfileSection::DrawTerrain);
+
 	float pwidth = mWorld->getWidth();
 	float pheight = mWorld->getHeight();
 	SDL_utils::drawSpriteWithColor(*mGrassTexture, Rectangle((-mCamera.x - pwidth) * mScaleLevel + screenWidth * 0.5f,
@@ -768,6 +828,8 @@ void Driver::drawTerrain()
 
 void Driver::drawTexts()
 {
+	ProfileScope profile(ProfileSection::DrawTexts);
+
 	if(mPaused) {
 		drawOverlayText("Paused", 2.0f, Common::Color::White, 0.5f, 0.5f, true);
 	}
@@ -970,10 +1032,16 @@ void Driver::drawTexts()
 				break;
 		}
 	}
+
+	// the texts are collected in the sprite batch
+	mSpriteBatch->flush();
+	setLight(); // reset glColor
 }
 
 void Driver::drawOverlays()
 {
+	ProfileScope profile(ProfileSection::DrawOverlays);
+
 	{
 		// goto-positions for the crew
 		if(mSoldier->getRank() == SoldierRank::Private) {
@@ -1020,6 +1088,37 @@ void Driver::drawOverlays()
 
 		mDebugSymbols.clear();
 	}
+
+	if(mShowProfiler && Profiler::getInstance()) {
+		// milliseconds per frame over the last frames
+		auto profiler = Profiler::getInstance();
+		drawOverlayText("avg ms    p99 ms", 1.0f, Common::Color::White,
+				screenWidth - 300.0f, 40.0f, false, true);
+		for(int i = 0; i < int(ProfileSection::NumSections); i++) {
+			auto stats = profiler->getStats(ProfileSection(i));
+			char buf[128];
+			snprintf(buf, 127, "%7.2f %7.2f  %s", stats.average, stats.p99,
+					Profiler::getSectionName(ProfileSection(i)));
+			buf[127] = 0;
+			drawOverlayText(buf, 1.0f, Common::Color::White,
+					screenWidth - 300.0f, 55.0f + 15.0f * i, false, true);
+		}
+
+		char buf[128];
+		snprintf(buf, 127, "%u sprites in %u draw calls", mSpriteBatch->getNumQuads(),
+				mSpriteBatch->getNumDrawCalls());
+		buf[127] = 0;
+		drawOverlayText(buf, 1.0f, Common::Color::White,
+				screenWidth - 300.0f, 55.0f + 15.0f * int(ProfileSection::NumSections), false, true);
+		snprintf(buf, 127, "%u terrain tiles in %u draw calls", mStaticGeometry->getNumTiles(),
+				mStaticGeometry->getNumDrawCalls());
+		buf[127] = 0;
+		drawOverlayText(buf, 1.0f, Common::Color::White,
+				screenWidth - 300.0f, 70.0f + 15.0f * int(ProfileSection::NumSections), false, true);
+	}
+
+	// the texts are drawn on top of the rest of the overlays
+	mSpriteBatch->flush();
 	setLight(); // reset glColor
 }
 
@@ -1163,6 +1262,7 @@ const boost::shared_ptr<Common::Texture> Driver::getUnitIconTexture(const UnitIc
 
 	auto t = boost::shared_ptr<Texture>(new Texture(branch));
 	mUnitIconTextures[d] = t;
+	mSpriteBatch->addToAtlas(*t);
 	return t;
 }
 
@@ -1199,8 +1299,11 @@ const boost::shared_ptr<Texture> Driver::unitIconTexture(const SoldierQuery& p,
 
 void Driver::drawEntities()
 {
-	static const float treeScale = 3.0f;
+	ProfileScope profile(ProfileSection::DrawEntities);
+
 	std::vector<Sprite> sprites;
+	mSpriteBatch->resetStats();
+	mStaticGeometry->setView(mCamera, mScaleLevel, screenWidth, screenHeight);
 
 	if(mMapLevel == MapLevel::Normal) {
 		std::set<Sprite> soldiers;
@@ -1306,34 +1409,33 @@ void Driver::drawEntities()
 		if(mObserver) {
 			for(auto f : mWorld->getFoxholesAt(mCamera, getDrawRadius())) {
 				sprites.push_back(Sprite(f->getPosition(), SpriteType::Foxhole,
-							4.0f, mFoxholeTexture, boost::shared_ptr<Texture>(),
+							4.0f, mFoxholeTexture.get(), nullptr,
 							-0.5f, -0.5f, 0.0f, 0.0f, clamp(0.0f, f->getDepth(), 1.0f)));
 			}
 		} else {
 			for(auto f : mSoldier->getSensedFoxholes()) {
 				sprites.push_back(Sprite(f.getPosition(), SpriteType::Foxhole,
-							4.0f, mFoxholeTexture, boost::shared_ptr<Texture>(),
+							4.0f, mFoxholeTexture.get(), nullptr,
 							-0.5f, -0.5f, 0.0f, 0.0f, clamp(0.0f, f.getDepth(), 1.0f)));
 			}
 		}
 
-		auto trees = mWorld->getTreesAt(mCamera, getDrawRadius());
-
-		for(auto t : trees) {
+		// the shadows of the trees are in the static geometry
+		for(auto t : mStaticGeometry->getVisibleTrees()) {
 			sprites.push_back(Sprite(t->getPosition(), SpriteType::Tree,
-						t->getRadius() * treeScale, mTreeTexture, mTreeShadowTexture, -0.5f, -0.5f,
+						t->getRadius() * treeScale, mTreeTexture.get(), nullptr, -0.5f, -0.5f,
 						-0.5f, -0.8f));
 		}
 
 		for(auto b : mWorld->getBulletsAt(mCamera, getDrawRadius())) {
-			if(!observefunc(b->getPosition())) {
+			if(!observefunc(b.getPosition())) {
 				continue;
 			}
 
-			float scale = b->getWeapon()->getDamageAgainstLightArmor() > 0.0f ? 5.0f : 1.0f;
-			sprites.push_back(Sprite(b->getPosition(), SpriteType::Bullet,
+			float scale = b.getWeapon()->getDamageAgainstLightArmor() > 0.0f ? 5.0f : 1.0f;
+			sprites.push_back(Sprite(interpolatedPosition(b.getPosition(), b.getVelocity()), SpriteType::Bullet,
 						scale,
-						boost::shared_ptr<Texture>(), boost::shared_ptr<Texture>(),
+						nullptr, nullptr,
 						0.0f, 0.5f / scale,
 						-0.8f / scale, -1.0f / scale));
 		}
@@ -1359,7 +1461,7 @@ void Driver::drawEntities()
 				}
 				sprites.push_back(Sprite(t->getPosition(), SpriteType::WeaponPickup,
 							2.0f,
-							mWeaponPickupTextures[int(tex)], boost::shared_ptr<Texture>(),
+							mWeaponPickupTextures[int(tex)].get(), nullptr,
 							-0.5f, -0.5f,
 							0.0f, 0.0f));
 			}
@@ -1382,7 +1484,8 @@ void Driver::drawEntities()
 			}
 		}
 
-		std::set<SoldierQuery> enemysoldiers;
+		static const std::set<SoldierQuery> noEnemySoldiers;
+		const std::set<SoldierQuery>* enemysoldiers = &noEnemySoldiers;
 		if(mSoldier->hasLeader()) {
 			auto l = mSoldier->getLeader();
 			if(mSoldier->canCommunicateWith(l)) {
@@ -1398,16 +1501,16 @@ void Driver::drawEntities()
 						}
 					}
 				}
-				enemysoldiers = l.getKnownEnemySoldiers();
+				enemysoldiers = &getKnownEnemySoldiers(l);
 			}
 		} else {
-			enemysoldiers = mSoldier->getKnownEnemySoldiers();
+			enemysoldiers = &getKnownEnemySoldiers(*mSoldier);
 		}
 
-		for(auto s : enemysoldiers) {
+		for(auto s : *enemysoldiers) {
 			if(s.isAlive() && (s.getRank() == SoldierRank::Sergeant ||
 					(s.getRank() == SoldierRank::Private &&
-						enemysoldiers.find(s.getLeader()) == enemysoldiers.end()))) {
+						enemysoldiers->find(s.getLeader()) == enemysoldiers->end()))) {
 				includeUnitIcon(soldiers, s, false);
 			}
 		}
@@ -1417,8 +1520,14 @@ void Driver::drawEntities()
 		}
 	}
 
+	// the tree shadows and the roads come from the static geometry, the
+	// rest of the shadows and the sprites, including the trees, are
+	// collected in the sprite batch.
+	if(mMapLevel == MapLevel::Normal)
+		mStaticGeometry->draw(StaticLayer::TreeShadows, mLight);
+
 	// draw shadows
-	for(auto s : sprites) {
+	for(const auto& s : sprites) {
 		if(!s.mShadowTexture && s.mSpriteType != SpriteType::Bullet)
 			continue;
 
@@ -1428,20 +1537,21 @@ void Driver::drawEntities()
 				mScaleLevel * s.mScale, mScaleLevel * s.mScale);
 
 		if(s.mSpriteType != SpriteType::Bullet) {
-			SDL_utils::drawSpriteWithColor(*s.mShadowTexture,
+			mSpriteBatch->addSprite(*s.mShadowTexture,
 					r,
-					Rectangle(1, 1, -1, -1), 0.0f, mLight, s.mAlpha);
+					Rectangle(1, 1, -1, -1), mLight, s.mAlpha);
 		} else {
-			SDL_utils::drawPoint(Vector3(r.x, r.y, 0.0f), s.mScale, Color::Black);
-			setLight(); // reset glColor
+			mSpriteBatch->addPoint(Vector3(r.x, r.y, 0.0f), s.mScale, Color::Black);
 		}
 	}
 
+	mSpriteBatch->flush();
+
 	std::sort(sprites.begin(), sprites.end());
 
-	drawRoads();
+	mStaticGeometry->draw(StaticLayer::Roads, Color::White);
 
-	for(auto s : sprites) {
+	for(const auto& s : sprites) {
 		if(!s.mTexture && s.mSpriteType != SpriteType::Bullet) {
 			std::cout << "texture missing.\n";
 			continue;
@@ -1453,11 +1563,10 @@ void Driver::drawEntities()
 				mScaleLevel * s.mScale, mScaleLevel * s.mScale);
 
 		if(s.mSpriteType != SpriteType::Bullet) {
-			SDL_utils::drawSpriteWithColor(*s.mTexture, r,
-					Rectangle(1, 1, -1, -1), 0.0f, mLight, s.mAlpha);
+			mSpriteBatch->addSprite(*s.mTexture, r,
+					Rectangle(1, 1, -1, -1), mLight, s.mAlpha);
 		} else {
-			SDL_utils::drawPoint(Vector3(r.x, r.y, 0.0f), s.mScale, Color::White);
-			setLight(); // reset glColor
+			mSpriteBatch->addPoint(Vector3(r.x, r.y, 0.0f), s.mScale, Color::White);
 		}
 
 #if 0
@@ -1467,43 +1576,9 @@ void Driver::drawEntities()
 		setLight(); // reset glColor
 #endif
 	}
-}
 
-void Driver::drawRoads()
-{
-	static const float roadWidth = 5.0f;
-	auto roads = mWorld->getRoadsAt(mCamera, getDrawRadius());
-
-	for(auto r : roads) {
-		auto p1 = r->getStart();
-		auto p2 = r->getEnd();
-		auto dir = p1 - p2;
-		const auto roadlen = dir.length();
-		dir = dir.normalized() * roadWidth;
-		// extend segments to avoid holes inbetween
-		p1 = p1 + dir * 0.5f;
-		p2 = p2 - dir * 0.5f;
-		const auto& p1l = terrainPositionToScreenPosition(p1 + Math::rotate2D(dir, -90.0f));
-		const auto& p1r = terrainPositionToScreenPosition(p1 + Math::rotate2D(dir, 90.0f));
-		const auto& p2l = terrainPositionToScreenPosition(p2 + Math::rotate2D(dir, -90.0f));
-		const auto& p2r = terrainPositionToScreenPosition(p2 + Math::rotate2D(dir, 90.0f));
-
-		assert(roadlen);
-
-		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-		glEnable(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, mRoadTexture->getTexture());
-		glBegin(GL_QUADS);
-		glTexCoord2f(1.0f, 0.0f);
-		glVertex3f(p1l.x, p1l.y, 0.0f);
-		glTexCoord2f(0.0f, 0.0f);
-		glVertex3f(p1r.x, p1r.y, 0.0f);
-		glTexCoord2f(0.0f, roadlen * 0.1f);
-		glVertex3f(p2r.x, p2r.y, 0.0f);
-		glTexCoord2f(1.0f, roadlen * 0.1f);
-		glVertex3f(p2l.x, p2l.y, 0.0f);
-		glEnd();
-	}
+	mSpriteBatch->flush();
+	setLight(); // reset glColor
 }
 
 void Driver::setFocusSoldier()
@@ -1529,8 +1604,9 @@ void Driver::setFocusSoldier()
 	if(soldiercandidates.empty())
 		return;
 
-	unsigned int i = Random::uniform() * soldiercandidates.size();
-	i = clamp((unsigned int)0, i, (unsigned int)soldiercandidates.size() - 1);
+	// use a separate generator so that the simulation doesn't depend on the UI
+	std::uniform_int_distribution<unsigned int> dist(0, soldiercandidates.size() - 1);
+	unsigned int i = dist(mFocusRandom);
 
 	auto s = soldiercandidates[i];
 	if(s == mFocusSoldier)
@@ -1545,9 +1621,8 @@ void Driver::setFocusSoldier()
 		// detach our agent from old soldier
 		{
 			if(mPlayerAgent) {
-				mAgentDirectory.removeAgent(olds, mPlayerAgent);
 				// failure => already dead
-				handleOld = true;
+				handleOld = mAgentDirectory.removeAgent(olds, mPlayerAgent);
 			}
 		}
 
@@ -1560,6 +1635,8 @@ void Driver::setFocusSoldier()
 		// attach our agent to new soldier
 		{
 			auto controller = SoldierControllerPtr(new SoldierController(mFocusSoldier));
+			if(mRecorder)
+				mRecorder->newController(mFocusSoldier->getID());
 			mPlayerAgent = boost::shared_ptr<PlayerAgent>(new PlayerAgent(controller, mInputState));
 			bool succ = mAgentDirectory.addAgent(mFocusSoldier, controller, mPlayerAgent);
 			assert(succ);
@@ -1569,6 +1646,8 @@ void Driver::setFocusSoldier()
 		{
 			if(handleOld) {
 				auto controller = SoldierControllerPtr(new SoldierController(olds));
+				if(mRecorder)
+					mRecorder->newController(olds->getID());
 				auto a = boost::shared_ptr<SoldierAgent>(new AI::SoldierAgent(controller));
 				bool succ = mAgentDirectory.addAgent(olds, controller, a);
 				assert(succ);
@@ -1602,11 +1681,10 @@ void Driver::updateMousePositionOnField()
 void Driver::drawText(const char* text, float size, const Common::Color& c,
 		const Common::Vector3& pos, bool centered)
 {
-	SDL_utils::drawText(mTextMap, mFont, mCamera, mScaleLevel, screenWidth, screenHeight,
-			pos.x,
-			pos.y,
-			FontConfig(text, c, size),
-			false, centered);
+	mTextRenderer->addText(text,
+			(-mCamera.x + pos.x) * mScaleLevel + screenWidth * 0.5f,
+			(-mCamera.y + pos.y) * mScaleLevel + screenHeight * 0.5f,
+			size * mScaleLevel, c, centered);
 }
 
 void Driver::drawSoldierName(const SoldierQuery& s, const Common::Color& c)
@@ -1659,9 +1737,7 @@ void Driver::drawOverlayText(const char* text, float size, const Common::Color&
 {
 	int xv = pixelcoords ? x : screenWidth * x;
 	int yv = pixelcoords ? y : screenHeight * y;
-	SDL_utils::drawText(mTextMap, mFont, mCamera, mScaleLevel, screenWidth, screenHeight,
-			xv, yv, FontConfig(text, c, size),
-			true, centered);
+	mTextRenderer->addText(text, xv, yv, size, c, centered);
 }
 
 Common::Color Driver::getGroupRectangleColor(const SoldierQuery& commandee, float brightness)
@@ -1714,14 +1790,15 @@ void Driver::includeSoldierSprite(std::set<Sprite>& sprites, const SoldierQuery&
 
 	boost::shared_ptr<Texture> t = soldierTexture(true, s.isDead(), s.getXYRotation(), s.getSideNum() == 0,
 			sxp, syp, xp, yp, scale);
-	sprites.insert(Sprite(s.getPosition(), SpriteType::Soldier, scale, t, mSoldierShadowTexture, xp, yp,
+	Vector3 pos = interpolatedPosition(s.getPosition(), s.getVelocity());
+	sprites.insert(Sprite(pos, SpriteType::Soldier, scale, t.get(), mSoldierShadowTexture.get(), xp, yp,
 				sxp, syp));
 
 	if(addbrightspot) {
-		Vector3 p = s.getPosition();
+		Vector3 p = pos;
 		p.y -= 0.001f;
-		sprites.insert(Sprite(p, SpriteType::BrightSpot, scale, mBrightSpot,
-					boost::shared_ptr<Common::Texture>(), xp, yp,
+		sprites.insert(Sprite(p, SpriteType::BrightSpot, scale, mBrightSpot.get(),
+					nullptr, xp, yp,
 					0.0f, 0.0f, 0.5f));
 	}
 }
@@ -1732,14 +1809,15 @@ void Driver::includeArmorSprite(std::set<Sprite>& sprites, const ArmorQuery& s,
 	float scale;
 	boost::shared_ptr<Texture> t = soldierTexture(false, s.isDestroyed(), s.getXYRotation(), s.getSideNum() == 0,
 			sxp, syp, xp, yp, scale);
-	sprites.insert(Sprite(s.getPosition(), SpriteType::Soldier, scale, t, mSoldierShadowTexture, xp, yp,
+	Vector3 pos = interpolatedPosition(s.getPosition(), s.getVelocity());
+	sprites.insert(Sprite(pos, SpriteType::Soldier, scale, t.get(), mSoldierShadowTexture.get(), xp, yp,
 				sxp, syp));
 
 	if(addbrightspot) {
-		Vector3 p = s.getPosition();
+		Vector3 p = pos;
 		p.y -= 0.001f;
-		sprites.insert(Sprite(p, SpriteType::BrightSpot, scale, mBrightSpot,
-					boost::shared_ptr<Common::Texture>(), xp, yp,
+		sprites.insert(Sprite(p, SpriteType::BrightSpot, scale, mBrightSpot.get(),
+					nullptr, xp, yp,
 					0.0f, 0.0f, 0.5f));
 	}
 }
@@ -1749,20 +1827,32 @@ void Driver::includeUnitIcon(std::set<Sprite>& sprites, const SoldierQuery& s, b
 	float scale = 0.0f;
 	boost::shared_ptr<Texture> t = unitIconTexture(s, scale);
 	auto pos = s.getUnitPosition();
-	sprites.insert(Sprite(pos, SpriteType::Icon, scale, t,
-				mUnitIconShadowTexture, 0.0f, 0.0f,
+	sprites.insert(Sprite(pos, SpriteType::Icon, scale, t.get(),
+				mUnitIconShadowTexture.get(), 0.0f, 0.0f,
 				0.0f, 0.0f));
 
 	if(addbrightspot) {
 		Vector3 p = pos;
 		p.x += 0.001f;
 		p.y -= 0.001f;
-		sprites.insert(Sprite(p, SpriteType::BrightSpot, scale, mBrightSpot,
-					boost::shared_ptr<Common::Texture>(), 0.0f, 0.0f,
+		sprites.insert(Sprite(p, SpriteType::BrightSpot, scale, mBrightSpot.get(),
+					nullptr, 0.0f, 0.0f,
 					0.0f, 0.0f, 0.5f));
 	}
 }
 
+// copied only when the leader or its known enemies change
+const std::set<SoldierQuery>& Driver::getKnownEnemySoldiers(const SoldierQuery& leader)
+{
+	unsigned int version = leader.getKnownEnemySoldiersVersion();
+	if(mKnownEnemiesLeader != leader || mKnownEnemiesVersion != version) {
+		mKnownEnemies = leader.getKnownEnemySoldiers();
+		mKnownEnemiesLeader = leader;
+		mKnownEnemiesVersion = version;
+	}
+	return mKnownEnemies;
+}
+
 bool Driver::allCommandeesDefending() const
 {
 	for(auto s : mSoldier->getCommandees()) {
@@ -2,6 +2,7 @@
 #define BRIGADES_DRIVER_H
 
 #include <array>
+#include <random>
 
 #include <boost/shared_ptr.hpp>
 
@@ -11,7 +12,6 @@
 #include "common/Clock.h"
 #include "common/Texture.h"
 #include "common/Color.h"
-#include "common/FontConfig.h"
 #include "common/Rectangle.h"
 
 #include "World.h"
@@ -24,6 +24,10 @@
 
 namespace Brigades {
 
+class SpriteBatch;
+class StaticGeometry;
+class TextRenderer;
+
 enum class SpriteType {
 	Soldier,
 	Tree,
@@ -34,18 +38,19 @@ enum class SpriteType {
 	Icon
 };
 
+// the textures are owned by the driver.
 struct Sprite {
 	Sprite(const Common::Vector3& pos, SpriteType t, float scale,
-			boost::shared_ptr<Common::Texture> texture,
-			boost::shared_ptr<Common::Texture> shadow, float xp, float yp,
+			const Common::Texture* texture,
+			const Common::Texture* shadow, float xp, float yp,
 			float sxp, float syp, float alpha = 1.0f)
 		: mPosition(pos), mSpriteType(t), mScale(scale), mTexture(texture), mShadowTexture(shadow),
 		mXP(xp), mYP(yp), mSXP(sxp), mSYP(syp), mAlpha(alpha) { }
 	Common::Vector3 mPosition;
 	SpriteType mSpriteType;
 	float mScale;
-	boost::shared_ptr<Common::Texture> mTexture;
-	boost::shared_ptr<Common::Texture> mShadowTexture;
+	const Common::Texture* mTexture;
+	const Common::Texture* mShadowTexture;
 	float mXP;
 	float mYP;
 	float mSXP;
@@ -148,10 +153,14 @@ bool UnitIconDescriptor::operator<(const UnitIconDescriptor& f) const
 
 class Driver : public DebugOutput, public InfoChannel {
 	public:
-		Driver(WorldPtr w, bool observer, SoldierRank r);
+		// tickrate is the number of fixed simulation ticks per second.
+		// 0 runs the simulation with the frame time instead.
+		Driver(WorldPtr w, bool observer, SoldierRank r, float tickrate);
 		~Driver();
 		void init();
 		void run();
+		// records the actions for a replay. Must be set before init().
+		void setReplayRecorder(ReplayRecorder* recorder);
 		void markArea(const Common::Color& c, const Common::Rectangle& r, bool onlyframes);
 		void addArrow(const Common::Color& c, const Common::Vector3& start, const Common::Vector3& arrow);
 		void addMessage(const SoldierQuery* s, const Common::Color& c, const char* text);
@@ -183,7 +192,6 @@ class Driver : public DebugOutput, public InfoChannel {
 		const boost::shared_ptr<Common::Texture> getUnitIconTexture(const UnitIconDescriptor& d);
 		const boost::shared_ptr<Common::Texture> unitIconTexture(const SoldierQuery& p, float& scale);
 		void drawEntities();
-		void drawRoads();
 		void setFocusSoldier();
 		Common::Vector3 getMousePositionOnField() const;
 		void updateMousePositionOnField();
@@ -200,10 +208,13 @@ class Driver : public DebugOutput, public InfoChannel {
 		void includeSoldierSprite(std::set<Sprite>& sprites, const SoldierQuery& s, bool addbrightspot = false);
 		void includeArmorSprite(std::set<Sprite>& sprites, const ArmorQuery& s, bool addbrightspot = false);
 		void includeUnitIcon(std::set<Sprite>& sprites, const SoldierQuery& s, bool addbrightspot = false);
+		const std::set<SoldierQuery>& getKnownEnemySoldiers(const SoldierQuery& leader);
 		bool allCommandeesDefending() const;
 		void setLight();
-		void updateAgents(float time);
 		void applyPendingActions();
+		void updateFixedStep(double frameTime);
+		void updateVariableStep(double frameTime);
+		Common::Vector3 interpolatedPosition(const Common::Vector3& pos, const Common::Vector3& vel) const;
 		Common::Vector3 terrainPositionToScreenPosition(const Common::Vector3& pos);
 
 		WorldPtr mWorld;
@@ -230,7 +241,6 @@ class Driver : public DebugOutput, public InfoChannel {
 		boost::shared_ptr<Common::Texture> mBrightSpot;
 		boost::shared_ptr<Common::Texture> mUnitIconShadowTexture;
 		boost::shared_ptr<Common::Texture> mRoadTexture;
-		Common::TextMap mTextMap;
 		SoldierQueryPtr mSoldier;
 		SoldierPtr mFocusSoldier;
 		bool mObserver;
@@ -238,6 +248,9 @@ class Driver : public DebugOutput, public InfoChannel {
 		DebugSymbolCollection mDebugSymbols;
 		std::array<InfoMessage, 5> mInfoMessages;
 		std::map<SoldierQuery, SpeechBubble> mSpeechBubbles;
+		SoldierQuery mKnownEnemiesLeader;
+		unsigned int mKnownEnemiesVersion = 0;
+		std::set<SoldierQuery> mKnownEnemies;
 		Common::Countdown mSpeechBubbleTimer;
 		unsigned int mNextInfoMessageIndex;
 		SoldierRank mSoldierRank;
@@ -248,12 +261,21 @@ class Driver : public DebugOutput, public InfoChannel {
 		bool mCreatingAttackOrder;
 		SoldierQueryPtr mSelectedCommandee;
 		float mTimeAcceleration;
+		float mTickTime;
+		double mTickAccumulator;
+		float mInterpolation;
 		MapLevel mMapLevel;
 		std::map<UnitIconDescriptor, boost::shared_ptr<Common::Texture>> mUnitIconTextures;
 		AgentDirectory mAgentDirectory;
+		ReplayRecorder* mRecorder = nullptr;
+		bool mShowProfiler = false;
+		boost::shared_ptr<SpriteBatch> mSpriteBatch;
+		boost::shared_ptr<StaticGeometry> mStaticGeometry;
+		boost::shared_ptr<TextRenderer> mTextRenderer;
 
 		Common::Color mLight;
 		std::vector<SoldierAction> mPendingActions;
+		std::default_random_engine mFocusRandom;
 };
 
 typedef boost::shared_ptr<Driver> DriverPtr;
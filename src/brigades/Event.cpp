@@ -12,40 +12,115 @@ Event::Event(EventType t)
 {
 }
 
+Event Event::soundEvent(SoldierPtr soundmaker)
+{
+	Event e(EventType::Sound);
+	e.mSoundMaker = soundmaker;
+	return e;
+}
+
+Event Event::weaponPickupEvent(WeaponPtr w)
+{
+	Event e(EventType::WeaponPickup);
+	e.mWeapon = w;
+	return e;
+}
+
 EventType Event::getType() const
 {
 	return mType;
 }
 
-SoundEvent::SoundEvent(SoldierPtr soundmaker)
-	: Event(EventType::Sound),
-	mSoundMaker(soundmaker)
+void Event::handleEvent(SoldierPtr p) const
 {
+	switch(mType) {
+		case EventType::Sound:
+			p->getSensorySystem()->addSound(mSoundMaker);
+			if(p->driving()) {
+				assert(p->getMountPoint());
+				p->getSensorySystem()->addSound(p->getMountPoint());
+			}
+			break;
+
+		case EventType::WeaponPickup:
+			if(p->hasWeaponType(mWeapon->getName()))
+				return;
+
+			p->addWeapon(mWeapon);
+			break;
+	}
 }
 
-void SoundEvent::handleEvent(SoldierPtr p)
+void EventQueue::add(int soldierid, const Event& e)
 {
-	p->getSensorySystem()->addSound(mSoundMaker);
-	if(p->driving()) {
-		assert(p->getMountPoint());
-		p->getSensorySystem()->addSound(p->getMountPoint());
+	assert(soldierid >= 0);
+	if((unsigned int)soldierid >= mHeads.size()) {
+		mHeads.resize(soldierid + 1, -1);
+		mTails.resize(soldierid + 1, -1);
 	}
+
+	int i = mEntries.size();
+	mEntries.push_back(Entry(e));
+	if(mTails[soldierid] == -1)
+		mHeads[soldierid] = i;
+	else
+		mEntries[mTails[soldierid]].next = i;
+	mTails[soldierid] = i;
 }
 
-WeaponPickupEvent::WeaponPickupEvent(WeaponPtr w)
-	: Event(EventType::WeaponPickup),
-	mWeapon(w)
+bool EventQueue::hasEvents(int soldierid) const
 {
+	return soldierid >= 0 && (unsigned int)soldierid < mHeads.size() &&
+		mHeads[soldierid] != -1;
 }
 
-void WeaponPickupEvent::handleEvent(SoldierPtr p)
+void EventQueue::remove(int soldierid)
 {
-	if(p->hasWeaponType(mWeapon->getName()))
+	handle(soldierid, [] (const Event&) { });
+}
+
+void EventQueue::compact()
+{
+	if(mNumHandled == 0)
+		return;
+
+	if(mNumHandled == mEntries.size()) {
+		mEntries.clear();
+		mNumHandled = 0;
 		return;
+	}
+
+	// move the remaining events to the front, keeping their order
+	mRemap.resize(mEntries.size());
+	unsigned int j = 0;
+	for(unsigned int i = 0; i < mEntries.size(); i++) {
+		if(mEntries[i].handled)
+			continue;
+		mRemap[i] = j;
+		if(i != j)
+			mEntries[j] = mEntries[i];
+		j++;
+	}
+	mEntries.erase(mEntries.begin() + j, mEntries.end());
 
-	p->addWeapon(mWeapon);
+	for(auto& e : mEntries) {
+		if(e.next != -1)
+			e.next = mRemap[e.next];
+	}
+
+	for(unsigned int i = 0; i < mHeads.size(); i++) {
+		if(mHeads[i] != -1) {
+			mHeads[i] = mRemap[mHeads[i]];
+			mTails[i] = mRemap[mTails[i]];
+		}
+	}
+	mNumHandled = 0;
 }
 
+unsigned int EventQueue::size() const
+{
+	return mEntries.size() - mNumHandled;
+}
 
 }
 
@@ -1,7 +1,10 @@
 #ifndef BRIGADES_EVENT_H
 #define BRIGADES_EVENT_H
 
+#include <vector>
+
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/Rectangle.h"
 
@@ -17,36 +20,80 @@ class Weapon;
 typedef boost::shared_ptr<Soldier> SoldierPtr;
 typedef boost::shared_ptr<Weapon> WeaponPtr;
 
+// Something that happened to a soldier, stored by value. Only the data
+// for the type of the event is set.
 class Event {
 	public:
-		Event(EventType t);
-		virtual ~Event() { }
+		static Event soundEvent(SoldierPtr soundmaker);
+		static Event weaponPickupEvent(WeaponPtr w);
 		EventType getType() const;
-		virtual void handleEvent(SoldierPtr p) = 0;
+		void handleEvent(SoldierPtr p) const;
 
 	private:
+		friend class boost::serialization::access;
+		friend class EventQueue;
+		Event(EventType t = EventType::Sound);
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		EventType mType;
+		SoldierPtr mSoundMaker;
+		WeaponPtr mWeapon;
 };
 
-class SoundEvent : public Event {
+// The events of all soldiers, kept in one array with a list running
+// through the events of each soldier. Handled events are dropped by
+// compact(); the events of a soldier that couldn't handle them yet are
+// kept. The storage is reused, so once it has grown large enough adding
+// events doesn't allocate.
+class EventQueue {
 	public:
-		SoundEvent(SoldierPtr soundmaker);
-		void handleEvent(SoldierPtr p);
+		void add(int soldierid, const Event& e);
+		bool hasEvents(int soldierid) const;
+		// calls f(e) for the events of the soldier in the order they
+		// were added and removes them.
+		template<typename F>
+		void handle(int soldierid, F f);
+		void remove(int soldierid);
+		void compact();
+		unsigned int size() const;
 
 	private:
-		SoldierPtr mSoundMaker;
-};
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
 
-class WeaponPickupEvent : public Event {
-	public:
-		WeaponPickupEvent(WeaponPtr w);
-		void handleEvent(SoldierPtr p);
+		struct Entry {
+			Entry(const Event& e) : event(e), next(-1), handled(false) { }
+			Event event;
+			int next;
+			bool handled;
+		};
 
-	private:
-		WeaponPtr mWeapon;
+		std::vector<Entry> mEntries;
+		// first and last entry of each soldier, by soldier ID
+		std::vector<int> mHeads;
+		std::vector<int> mTails;
+		std::vector<int> mRemap;
+		unsigned int mNumHandled = 0;
 };
 
-typedef boost::shared_ptr<Event> EventPtr;
+template<typename F>
+void EventQueue::handle(int soldierid, F f)
+{
+	if(!hasEvents(soldierid))
+		return;
+
+	int i = mHeads[soldierid];
+	mHeads[soldierid] = mTails[soldierid] = -1;
+	while(i != -1) {
+		Entry& e = mEntries[i];
+		f(e.event);
+		e.handled = true;
+		mNumHandled++;
+		i = e.next;
+	}
+}
 
 }
 
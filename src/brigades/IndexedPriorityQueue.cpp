@@ -0,0 +1,103 @@
+#include <cassert>
+
+#include "IndexedPriorityQueue.h"
+
+namespace Brigades {
+
+IndexedPriorityQueue::IndexedPriorityQueue(unsigned int size)
+	: mPriorities(size),
+	mPositions(size, -1)
+{
+}
+
+bool IndexedPriorityQueue::empty() const
+{
+	return mHeap.empty();
+}
+
+bool IndexedPriorityQueue::contains(int item) const
+{
+	return mPositions[item] != -1;
+}
+
+void IndexedPriorityQueue::push(int item, int priority)
+{
+	if(contains(item)) {
+		assert(priority <= mPriorities[item]);
+		mPriorities[item] = priority;
+		siftUp(mPositions[item]);
+	} else {
+		mPriorities[item] = priority;
+		mHeap.push_back(item);
+		mPositions[item] = mHeap.size() - 1;
+		siftUp(mHeap.size() - 1);
+	}
+}
+
+int IndexedPriorityQueue::pop()
+{
+	assert(!mHeap.empty());
+	int top = mHeap[0];
+	mPositions[top] = -1;
+	int last = mHeap.back();
+	mHeap.pop_back();
+	if(!mHeap.empty()) {
+		place(0, last);
+		siftDown(0);
+	}
+	return top;
+}
+
+void IndexedPriorityQueue::clear()
+{
+	for(auto i : mHeap)
+		mPositions[i] = -1;
+	mHeap.clear();
+}
+
+bool IndexedPriorityQueue::less(int item1, int item2) const
+{
+	if(mPriorities[item1] != mPriorities[item2])
+		return mPriorities[item1] < mPriorities[item2];
+	return item1 < item2;
+}
+
+void IndexedPriorityQueue::place(unsigned int pos, int item)
+{
+	mHeap[pos] = item;
+	mPositions[item] = pos;
+}
+
+void IndexedPriorityQueue::siftUp(unsigned int pos)
+{
+	int item = mHeap[pos];
+	while(pos > 0) {
+		unsigned int parent = (pos - 1) / 2;
+		if(!less(item, mHeap[parent]))
+			break;
+		place(pos, mHeap[parent]);
+		pos = parent;
+	}
+	place(pos, item);
+}
+
+void IndexedPriorityQueue::siftDown(unsigned int pos)
+{
+	int item = mHeap[pos];
+	unsigned int size = mHeap.size();
+	while(1) {
+		unsigned int child = pos * 2 + 1;
+		if(child >= size)
+			break;
+		if(child + 1 < size && less(mHeap[child + 1], mHeap[child]))
+			child++;
+		if(!less(mHeap[child], item))
+			break;
+		place(pos, mHeap[child]);
+		pos = child;
+	}
+	place(pos, item);
+}
+
+}
+
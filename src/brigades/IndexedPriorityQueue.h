@@ -0,0 +1,38 @@
+#ifndef BRIGADES_INDEXEDPRIORITYQUEUE_H
+#define BRIGADES_INDEXEDPRIORITYQUEUE_H
+
+#include <vector>
+
+namespace Brigades {
+
+// A binary min-heap of the items 0 to size - 1 that knows where each item
+// is, so the priority of a queued item can be lowered in place instead of
+// queueing it again. Items with the same priority are popped in the order
+// of their indices.
+class IndexedPriorityQueue {
+	public:
+		IndexedPriorityQueue(unsigned int size);
+		bool empty() const;
+		bool contains(int item) const;
+		// queues the item or lowers the priority of a queued item.
+		void push(int item, int priority);
+		// removes and returns the item with the lowest priority.
+		int pop();
+		void clear();
+
+	private:
+		bool less(int item1, int item2) const;
+		void siftUp(unsigned int pos);
+		void siftDown(unsigned int pos);
+		void place(unsigned int pos, int item);
+
+		std::vector<int> mHeap;
+		// by item
+		std::vector<int> mPriorities;
+		std::vector<int> mPositions;
+};
+
+}
+
+#endif
+
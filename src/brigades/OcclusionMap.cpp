@@ -0,0 +1,143 @@
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <algorithm>
+
+#include "OcclusionMap.h"
+
+using namespace Common;
+
+namespace Brigades {
+
+const int OcclusionMap::ChunkShift;
+const int OcclusionMap::ChunkSize;
+const int OcclusionMap::ChunkWords;
+
+OcclusionMap::OcclusionMap(float width, float height, float cellsize)
+	: mWidth(width),
+	mHeight(height),
+	mCellSize(cellsize),
+	mColumns(std::max(1, int(ceil(width / cellsize)))),
+	mRows(std::max(1, int(ceil(height / cellsize)))),
+	mChunkColumns((mColumns + ChunkSize - 1) / ChunkSize),
+	mChunks(mChunkColumns * ((mRows + ChunkSize - 1) / ChunkSize))
+{
+}
+
+bool OcclusionMap::blocked(int x, int y) const
+{
+	if(x < 0 || y < 0 || x >= mColumns || y >= mRows)
+		return false;
+
+	const auto& chunk = mChunks[(y >> ChunkShift) * mChunkColumns + (x >> ChunkShift)];
+	if(chunk.empty())
+		return false;
+
+	unsigned int i = (y & (ChunkSize - 1)) * ChunkSize + (x & (ChunkSize - 1));
+	return chunk[i / 32] & (1u << (i % 32));
+}
+
+void OcclusionMap::setBlocked(int x, int y)
+{
+	if(x < 0 || y < 0 || x >= mColumns || y >= mRows)
+		return;
+
+	auto& chunk = mChunks[(y >> ChunkShift) * mChunkColumns + (x >> ChunkShift)];
+	if(chunk.empty())
+		chunk.resize(ChunkWords);
+
+	unsigned int i = (y & (ChunkSize - 1)) * ChunkSize + (x & (ChunkSize - 1));
+	chunk[i / 32] |= 1u << (i % 32);
+}
+
+void OcclusionMap::clearArea(const Vector3& minpos, const Vector3& maxpos)
+{
+	int minx = std::max(0, int(ceil((minpos.x + mWidth * 0.5f) / mCellSize - 0.5f)));
+	int miny = std::max(0, int(ceil((minpos.y + mHeight * 0.5f) / mCellSize - 0.5f)));
+	int maxx = std::min(mColumns - 1, int(floor((maxpos.x + mWidth * 0.5f) / mCellSize - 0.5f)));
+	int maxy = std::min(mRows - 1, int(floor((maxpos.y + mHeight * 0.5f) / mCellSize - 0.5f)));
+
+	for(int y = miny; y <= maxy; y++) {
+		for(int x = minx; x <= maxx; x++) {
+			auto& chunk = mChunks[(y >> ChunkShift) * mChunkColumns + (x >> ChunkShift)];
+			if(chunk.empty())
+				continue;
+
+			unsigned int i = (y & (ChunkSize - 1)) * ChunkSize + (x & (ChunkSize - 1));
+			chunk[i / 32] &= ~(1u << (i % 32));
+		}
+	}
+
+	for(int cy = miny >> ChunkShift; cy <= maxy >> ChunkShift; cy++) {
+		for(int cx = minx >> ChunkShift; cx <= maxx >> ChunkShift; cx++) {
+			auto& chunk = mChunks[cy * mChunkColumns + cx];
+			if(std::all_of(chunk.begin(), chunk.end(), [] (uint32_t w) { return w == 0; }))
+				std::vector<uint32_t>().swap(chunk);
+		}
+	}
+}
+
+void OcclusionMap::addCircle(const Vector3& pos, float radius)
+{
+	float cx = (pos.x + mWidth * 0.5f) / mCellSize;
+	float cy = (pos.y + mHeight * 0.5f) / mCellSize;
+	float r = radius / mCellSize;
+	float r2 = r * r;
+
+	for(int y = int(floor(cy - r)); y <= int(ceil(cy + r)); y++) {
+		for(int x = int(floor(cx - r)); x <= int(ceil(cx + r)); x++) {
+			float dx = x + 0.5f - cx;
+			float dy = y + 0.5f - cy;
+			if(dx * dx + dy * dy <= r2)
+				setBlocked(x, y);
+		}
+	}
+}
+
+bool OcclusionMap::isBlocked(const Vector3& pos) const
+{
+	return blocked(int(floor((pos.x + mWidth * 0.5f) / mCellSize)),
+			int(floor((pos.y + mHeight * 0.5f) / mCellSize)));
+}
+
+bool OcclusionMap::lineBlocked(const Vector3& from, const Vector3& to) const
+{
+	float x0 = (from.x + mWidth * 0.5f) / mCellSize;
+	float y0 = (from.y + mHeight * 0.5f) / mCellSize;
+	float x1 = (to.x + mWidth * 0.5f) / mCellSize;
+	float y1 = (to.y + mHeight * 0.5f) / mCellSize;
+
+	int cx = int(floor(x0));
+	int cy = int(floor(y0));
+	int n = abs(int(floor(x1)) - cx) + abs(int(floor(y1)) - cy);
+
+	float dx = x1 - x0;
+	float dy = y1 - y0;
+	int stepx = dx > 0.0f ? 1 : -1;
+	int stepy = dy > 0.0f ? 1 : -1;
+
+	// distance along the line, in units of the line length, to cross one
+	// cell and to reach the next cell boundary on each axis
+	float deltax = dx != 0.0f ? fabs(1.0f / dx) : FLT_MAX;
+	float deltay = dy != 0.0f ? fabs(1.0f / dy) : FLT_MAX;
+	float tx = dx == 0.0f ? FLT_MAX : dx > 0.0f ? (cx + 1 - x0) * deltax : (x0 - cx) * deltax;
+	float ty = dy == 0.0f ? FLT_MAX : dy > 0.0f ? (cy + 1 - y0) * deltay : (y0 - cy) * deltay;
+
+	for(int i = 0; i < n - 1; i++) {
+		if(tx < ty) {
+			tx += deltax;
+			cx += stepx;
+		} else {
+			ty += deltay;
+			cy += stepy;
+		}
+
+		if(blocked(cx, cy))
+			return true;
+	}
+
+	return false;
+}
+
+}
+
@@ -0,0 +1,52 @@
+#ifndef BRIGADES_OCCLUSIONMAP_H
+#define BRIGADES_OCCLUSIONMAP_H
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "common/Vector3.h"
+
+namespace Brigades {
+
+// Bitmap of the cells covered by obstacles over a world centered at the
+// origin. A cell is blocked if its center is inside an obstacle. The
+// bitmap is stored in chunks of 64x64 cells that are only allocated once
+// something is added to them, so a large map with obstacles only in some
+// areas stays small.
+class OcclusionMap {
+	public:
+		OcclusionMap(float width, float height, float cellsize);
+		void addCircle(const Common::Vector3& pos, float radius);
+		// unblocks the cells with their centers in the rectangle and
+		// frees the chunks that become empty.
+		void clearArea(const Common::Vector3& minpos, const Common::Vector3& maxpos);
+		bool isBlocked(const Common::Vector3& pos) const;
+
+		// walks the cells between the points. The cells of the end
+		// points are not checked so that standing right next to a tree
+		// doesn't block the view.
+		bool lineBlocked(const Common::Vector3& from, const Common::Vector3& to) const;
+
+	private:
+		bool blocked(int x, int y) const;
+		void setBlocked(int x, int y);
+
+		static const int ChunkShift = 6;
+		static const int ChunkSize = 1 << ChunkShift;
+		static const int ChunkWords = ChunkSize * ChunkSize / 32;
+
+		float mWidth;
+		float mHeight;
+		float mCellSize;
+		int mColumns;
+		int mRows;
+		int mChunkColumns;
+		// empty if nothing is blocked in the chunk
+		std::vector<std::vector<uint32_t>> mChunks;
+};
+
+}
+
+#endif
+
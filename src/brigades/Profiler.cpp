@@ -0,0 +1,197 @@
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
+
+#include "Profiler.h"
+
+namespace Brigades {
+
+boost::shared_ptr<Profiler> ProfilerInstance;
+
+static std::atomic<unsigned int> NextProfilerID(1);
+
+// the buffer of the current thread for the profiler with the ID
+struct CurrentThreadBuffer {
+	unsigned int profiler;
+	void* buffer;
+};
+
+static thread_local CurrentThreadBuffer CurrentBuffer = { 0, nullptr };
+
+Profiler::Profiler()
+	: mID(NextProfilerID++),
+	mStartTime(now()),
+	mHistory(HistorySize),
+	mNumFrames(0)
+{
+}
+
+uint64_t Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* Profiler::getSectionName(ProfileSection s)
+{
+	switch(s) {
+		case ProfileSection::Frame:         return "Frame";
+		case ProfileSection::WorldUpdate:   return "World::update";
+		case ProfileSection::Vehicles:      return "Vehicles";
+		case ProfileSection::Soldiers:      return "Soldiers";
+		case ProfileSection::Vision:        return "World::updateVision";
+		case ProfileSection::SensorySystem: return "SensorySystem::updateFOV";
+		case ProfileSection::Bullets:       return "World::updateBullets";
+		case ProfileSection::Triggers:      return "World::updateTriggerSystem";
+		case ProfileSection::Agents:        return "AgentDirectory::update";
+		case ProfileSection::DrawTerrain:   return "Driver::drawTerrain";
+		case ProfileSection::DrawEntities:  return "Driver::drawEntities";
+		case ProfileSection::DrawTexts:     return "Driver::drawTexts";
+		case ProfileSection::DrawOverlays:  return "Driver::drawOverlays";
+		case ProfileSection::NumSections:   break;
+	}
+	assert(0);
+	return "";
+}
+
+Profiler::ThreadBuffer* Profiler::getThreadBuffer()
+{
+	if(CurrentBuffer.profiler != mID) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		boost::shared_ptr<ThreadBuffer> b(new ThreadBuffer());
+		b->thread = mBuffers.size();
+		b->samples.resize(BufferSize);
+		b->written = 0;
+		b->summed = 0;
+		mBuffers.push_back(b);
+		CurrentBuffer.profiler = mID;
+		CurrentBuffer.buffer = b.get();
+	}
+	return static_cast<ThreadBuffer*>(CurrentBuffer.buffer);
+}
+
+void Profiler::record(ProfileSection s, uint64_t start, uint64_t end)
+{
+	ThreadBuffer* b = getThreadBuffer();
+	uint64_t n = b->written.load(std::memory_order_relaxed);
+	Sample& sample = b->samples[n % BufferSize];
+	sample.start = start;
+	sample.end = end;
+	sample.section = s;
+	b->written.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::endFrame()
+{
+	FrameTimes& times = mHistory[mNumFrames % HistorySize];
+	times.fill(0.0f);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	for(auto& b : mBuffers) {
+		uint64_t written = b->written.load(std::memory_order_acquire);
+		uint64_t first = std::max(b->summed, written > BufferSize ? written - BufferSize : 0);
+		for(uint64_t i = first; i < written; i++) {
+			const Sample& s = b->samples[i % BufferSize];
+			times[int(s.section)] += (s.end - s.start) * 1e-6f;
+		}
+		b->summed = written;
+	}
+	mNumFrames++;
+}
+
+Profiler::Stats Profiler::getStats(ProfileSection s) const
+{
+	Stats stats = { 0.0f, 0.0f };
+	unsigned int n = std::min(mNumFrames, HistorySize);
+	if(n == 0)
+		return stats;
+
+	std::vector<float> times(n);
+	for(unsigned int i = 0; i < n; i++) {
+		times[i] = mHistory[i][int(s)];
+		stats.average += times[i];
+	}
+	stats.average /= n;
+
+	auto p99 = times.begin() + (n - 1) * 99 / 100;
+	std::nth_element(times.begin(), p99, times.end());
+	stats.p99 = *p99;
+	return stats;
+}
+
+unsigned int Profiler::getNumFrames() const
+{
+	return mNumFrames;
+}
+
+// the samples of all threads ordered by their start time
+std::vector<std::pair<unsigned int, Profiler::Sample>> Profiler::getSamples() const
+{
+	std::vector<std::pair<unsigned int, Sample>> samples;
+	std::lock_guard<std::mutex> lock(mMutex);
+	for(auto& b : mBuffers) {
+		uint64_t written = b->written.load(std::memory_order_acquire);
+		uint64_t first = written > BufferSize ? written - BufferSize : 0;
+		for(uint64_t i = first; i < written; i++)
+			samples.push_back({b->thread, b->samples[i % BufferSize]});
+	}
+	std::stable_sort(samples.begin(), samples.end(), [] (const std::pair<unsigned int, Sample>& a,
+				const std::pair<unsigned int, Sample>& b) {
+			return a.second.start < b.second.start; });
+	return samples;
+}
+
+bool Profiler::writeFile(const std::string& filename) const
+{
+	std::ofstream os(filename);
+	if(!os)
+		return false;
+
+	const std::string ext = ".json";
+	if(filename.size() >= ext.size() &&
+			filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0)
+		writeChromeTrace(os);
+	else
+		writeCSV(os);
+	return bool(os);
+}
+
+void Profiler::writeCSV(std::ostream& os) const
+{
+	auto flags = os.flags();
+	auto precision = os.precision();
+	os << std::fixed << std::setprecision(3);
+	os << "thread,section,start_us,duration_us\n";
+	for(auto& s : getSamples()) {
+		os << s.first << "," << getSectionName(s.second.section) << ","
+			<< (s.second.start - mStartTime) / 1000.0 << ","
+			<< (s.second.end - s.second.start) / 1000.0 << "\n";
+	}
+	os.flags(flags);
+	os.precision(precision);
+}
+
+void Profiler::writeChromeTrace(std::ostream& os) const
+{
+	auto flags = os.flags();
+	auto precision = os.precision();
+	os << std::fixed << std::setprecision(3);
+	os << "{\"traceEvents\":[\n";
+	bool first = true;
+	for(auto& s : getSamples()) {
+		if(!first)
+			os << ",\n";
+		first = false;
+		os << "{\"name\":\"" << getSectionName(s.second.section) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+			<< s.first << ",\"ts\":" << (s.second.start - mStartTime) / 1000.0
+			<< ",\"dur\":" << (s.second.end - s.second.start) / 1000.0 << "}";
+	}
+	os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	os.flags(flags);
+	os.precision(precision);
+}
+
+}
+
@@ -0,0 +1,134 @@
+#ifndef BRIGADES_PROFILER_H
+#define BRIGADES_PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+
+namespace Brigades {
+
+enum class ProfileSection {
+	Frame,
+	WorldUpdate,
+	Vehicles,
+	Soldiers,
+	Vision,
+	SensorySystem,
+	Bullets,
+	Triggers,
+	Agents,
+	DrawTerrain,
+	DrawEntities,
+	DrawTexts,
+	DrawOverlays,
+	NumSections
+};
+
+// Collects the time spent in the sections marked with ProfileScope.
+// Each thread records its samples into a ring buffer of its own, so
+// recording doesn't lock. At the end of each frame the samples are summed
+// up per section, and the sums of the last frames are kept for the
+// statistics. Profiling is off when no instance is set.
+class Profiler {
+	public:
+		static inline boost::shared_ptr<Profiler> getInstance();
+		static inline void setInstance(boost::shared_ptr<Profiler> p);
+
+		struct Stats {
+			// milliseconds per frame
+			float average;
+			float p99;
+		};
+
+		Profiler();
+		// monotonic time in nanoseconds
+		static uint64_t now();
+		static const char* getSectionName(ProfileSection s);
+
+		void record(ProfileSection s, uint64_t start, uint64_t end);
+		// sums up the samples recorded since the previous call. Must not
+		// be called while other threads are recording.
+		void endFrame();
+		Stats getStats(ProfileSection s) const;
+		unsigned int getNumFrames() const;
+
+		// the samples still in the ring buffers as CSV, or as a Chrome
+		// trace (chrome://tracing) if the file name ends with .json.
+		// Returns false if the file couldn't be written.
+		bool writeFile(const std::string& filename) const;
+		void writeCSV(std::ostream& os) const;
+		void writeChromeTrace(std::ostream& os) const;
+
+	private:
+		struct Sample {
+			uint64_t start;
+			uint64_t end;
+			ProfileSection section;
+		};
+
+		struct ThreadBuffer {
+			unsigned int thread;
+			std::vector<Sample> samples;
+			std::atomic<uint64_t> written;
+			uint64_t summed;
+		};
+
+		typedef std::array<float, int(ProfileSection::NumSections)> FrameTimes;
+
+		ThreadBuffer* getThreadBuffer();
+		std::vector<std::pair<unsigned int, Sample>> getSamples() const;
+
+		static const unsigned int BufferSize = 1 << 17;
+		static const unsigned int HistorySize = 300;
+
+		unsigned int mID;
+		uint64_t mStartTime;
+		mutable std::mutex mMutex;
+		std::vector<boost::shared_ptr<ThreadBuffer>> mBuffers;
+		std::vector<FrameTimes> mHistory;
+		unsigned int mNumFrames;
+};
+
+extern boost::shared_ptr<Profiler> ProfilerInstance;
+
+boost::shared_ptr<Profiler> Profiler::getInstance()
+{
+	return ProfilerInstance;
+}
+
+void Profiler::setInstance(boost::shared_ptr<Profiler> p)
+{
+	ProfilerInstance = p;
+}
+
+// Records the time until the end of the scope for the section. The
+// instance must not be reset or replaced while a scope is open.
+class ProfileScope {
+	public:
+		ProfileScope(ProfileSection s)
+			: mProfiler(ProfilerInstance.get()),
+			mSection(s),
+			mStart(mProfiler ? Profiler::now() : 0) { }
+		~ProfileScope()
+		{
+			if(mProfiler)
+				mProfiler->record(mSection, mStart, Profiler::now());
+		}
+
+	private:
+		Profiler* mProfiler;
+		ProfileSection mSection;
+		uint64_t mStart;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,458 @@
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include "Replay.h"
+#include "Scenario.h"
+#include "AgentDirectory.h"
+#include "ai/SoldierAgent.h"
+
+using namespace Common;
+
+namespace Brigades {
+
+static const char replayMagic[] = "BRIGREPL";
+static const char replayVersion = 2;
+
+// a checksum is recorded every this many ticks
+static const unsigned int checksumInterval = 50;
+
+enum class ReplayTag : unsigned char {
+	End,
+	Tick,
+	TickWithTime,
+	Actions,
+	RepeatedActions,
+	SameActionsAsPreviousTick,
+	EndOfTick,
+	PlayerActions,
+	NewController,
+	Checksum,
+};
+
+static void writeVarint(std::string& buf, unsigned int v)
+{
+	while(v >= 0x80) {
+		buf.push_back(char(v | 0x80));
+		v >>= 7;
+	}
+	buf.push_back(char(v));
+}
+
+static void writeFloat(std::string& buf, float f)
+{
+	char b[sizeof(f)];
+	memcpy(b, &f, sizeof(f));
+	buf.append(b, sizeof(f));
+}
+
+static void writeTag(std::string& buf, ReplayTag t)
+{
+	buf.push_back(char(t));
+}
+
+static void hash(unsigned int& h, const void* data, unsigned int len)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for(unsigned int i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+}
+
+// FNV-1a over the state of all soldiers in the world
+static unsigned int stateChecksum(WorldPtr world)
+{
+	auto soldiers = world->getSoldiersAt(Vector3(0.0f, 0.0f, 0.0f),
+			std::max(world->getWidth(), world->getHeight()));
+	std::sort(soldiers.begin(), soldiers.end(),
+			[] (const SoldierPtr& s1, const SoldierPtr& s2) {
+			return s1->getID() < s2->getID();
+			});
+
+	unsigned int h = 2166136261u;
+	for(auto& s : soldiers) {
+		int id = s->getID();
+		bool dead = s->isDead();
+		float health = s->getHealth();
+		hash(h, &id, sizeof(id));
+		hash(h, &dead, sizeof(dead));
+		hash(h, &health, sizeof(health));
+		hash(h, &s->getPosition(), sizeof(Vector3));
+		hash(h, &s->getVelocity(), sizeof(Vector3));
+	}
+
+	unsigned int bullets = world->getNumBullets();
+	hash(h, &bullets, sizeof(bullets));
+	return h;
+}
+
+// only the data used by the type of the action is written.
+void ReplayRecorder::writeActions(std::string& buf, const std::vector<SoldierAction>& actions)
+{
+	writeVarint(buf, actions.size());
+	for(auto& a : actions) {
+		buf.push_back(char(a.mType));
+		switch(a.mType) {
+			case SAType::Turn:
+			case SAType::Move:
+			case SAType::Shoot:
+				writeFloat(buf, a.mVec.x);
+				writeFloat(buf, a.mVec.y);
+				writeFloat(buf, a.mVec.z);
+				break;
+
+			case SAType::TurnBy:
+			case SAType::LineFormation:
+			case SAType::ColumnFormation:
+				writeFloat(buf, a.mVal);
+				break;
+
+			case SAType::SwitchWeapon:
+				writeVarint(buf, a.mIntValue);
+				break;
+
+			case SAType::Communication:
+				writeVarint(buf, a.mCommandedSoldier.queryIsValid() ?
+						a.mCommandedSoldier.getID() : 0);
+				buf.push_back(char(a.mCommunication));
+				if(a.mCommunication == CommunicationType::Order) {
+					buf.push_back(char(a.mOrder));
+					writeFloat(buf, a.mVec.x);
+					writeFloat(buf, a.mVec.y);
+					writeFloat(buf, a.mVec.z);
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+}
+
+ReplayRecorder::ReplayRecorder(std::ostream& os, const Scenario& scenario, int seed, WorldPtr world)
+	: mWorld(world)
+{
+	char header[3] = { replayVersion, scenario.isArcade(), scenario.isSkirmish() };
+	int mapSize = scenario.getMapSize();
+	char seedbuf[sizeof(seed)];
+	char sizebuf[sizeof(mapSize)];
+	memcpy(seedbuf, &seed, sizeof(seed));
+	memcpy(sizebuf, &mapSize, sizeof(mapSize));
+	os.write(replayMagic, sizeof(replayMagic));
+	os.write(header, sizeof(header));
+	os.write(seedbuf, sizeof(seedbuf));
+	os.write(sizebuf, sizeof(sizebuf));
+
+	mOut.push(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed));
+	mOut.push(os);
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+	mOut.write(mBetweenTicks.data(), mBetweenTicks.size());
+	mOut.put(char(ReplayTag::End));
+	mOut.reset();
+}
+
+void ReplayRecorder::addPlayerActions(int soldierid, const std::vector<SoldierAction>& actions)
+{
+	if(actions.empty())
+		return;
+
+	writeTag(mBetweenTicks, ReplayTag::PlayerActions);
+	writeVarint(mBetweenTicks, soldierid);
+	writeActions(mBetweenTicks, actions);
+}
+
+void ReplayRecorder::newController(int soldierid)
+{
+	writeTag(mBetweenTicks, ReplayTag::NewController);
+	writeVarint(mBetweenTicks, soldierid);
+}
+
+void ReplayRecorder::startTick(float time)
+{
+	mTime = time;
+	mPreviousID = 0;
+	mTick.clear();
+}
+
+void ReplayRecorder::addActions(int soldierid, const std::vector<SoldierAction>& actions)
+{
+	assert(soldierid > mPreviousID);
+	mActionBuffer.clear();
+	writeActions(mActionBuffer, actions);
+
+	if((unsigned int)soldierid >= mLastActions.size())
+		mLastActions.resize(soldierid + 1);
+
+	if(mLastActions[soldierid] == mActionBuffer) {
+		writeTag(mTick, ReplayTag::RepeatedActions);
+		writeVarint(mTick, soldierid - mPreviousID);
+	} else {
+		writeTag(mTick, ReplayTag::Actions);
+		writeVarint(mTick, soldierid - mPreviousID);
+		mTick += mActionBuffer;
+		mLastActions[soldierid].swap(mActionBuffer);
+	}
+	mPreviousID = soldierid;
+}
+
+void ReplayRecorder::endTick()
+{
+	if(mNumTicks == 0 || mTime != mPreviousTime) {
+		writeTag(mBetweenTicks, ReplayTag::TickWithTime);
+		writeFloat(mBetweenTicks, mTime);
+		mPreviousTime = mTime;
+	} else {
+		writeTag(mBetweenTicks, ReplayTag::Tick);
+	}
+
+	if(mNumTicks > 0 && mTick == mPreviousTick) {
+		writeTag(mBetweenTicks, ReplayTag::SameActionsAsPreviousTick);
+	} else {
+		mBetweenTicks += mTick;
+		writeTag(mBetweenTicks, ReplayTag::EndOfTick);
+		mPreviousTick.swap(mTick);
+	}
+
+	mNumTicks++;
+	if(mNumTicks % checksumInterval == 0) {
+		unsigned int checksum = stateChecksum(mWorld);
+		writeTag(mBetweenTicks, ReplayTag::Checksum);
+		mBetweenTicks.append((const char*)&checksum, sizeof(checksum));
+	}
+
+	mOut.write(mBetweenTicks.data(), mBetweenTicks.size());
+	mBetweenTicks.clear();
+}
+
+unsigned int ReplayRecorder::getNumTicks() const
+{
+	return mNumTicks;
+}
+
+
+ReplayPlayer::ReplayPlayer(std::istream& is)
+	: mSource(is)
+{
+}
+
+bool ReplayPlayer::readHeader(bool& arcade, bool& skirmish, int& seed, int& mapSize)
+{
+	char magic[sizeof(replayMagic)];
+	char header[3];
+	char seedbuf[sizeof(seed)];
+	char sizebuf[sizeof(mapSize)];
+	mSource.read(magic, sizeof(magic));
+	mSource.read(header, sizeof(header));
+	mSource.read(seedbuf, sizeof(seedbuf));
+	mSource.read(sizebuf, sizeof(sizebuf));
+	if(!mSource || memcmp(magic, replayMagic, sizeof(magic)) || header[0] != replayVersion)
+		return false;
+
+	arcade = header[1];
+	skirmish = header[2];
+	memcpy(&seed, seedbuf, sizeof(seed));
+	memcpy(&mapSize, sizebuf, sizeof(mapSize));
+
+	mIn.push(boost::iostreams::zlib_decompressor());
+	mIn.push(mSource);
+	return true;
+}
+
+unsigned char ReplayPlayer::readByte()
+{
+	int c = mIn.get();
+	if(c == EOF)
+		throw std::runtime_error("Replay: unexpected end of file");
+	return c;
+}
+
+unsigned int ReplayPlayer::readVarint()
+{
+	unsigned int v = 0;
+	for(int shift = 0; shift < 32; shift += 7) {
+		unsigned char c = readByte();
+		v |= (c & 0x7f) << shift;
+		if(!(c & 0x80))
+			return v;
+	}
+	throw std::runtime_error("Replay: invalid number");
+}
+
+float ReplayPlayer::readFloat()
+{
+	float f;
+	char b[sizeof(f)];
+	for(unsigned int i = 0; i < sizeof(f); i++)
+		b[i] = readByte();
+	memcpy(&f, b, sizeof(f));
+	return f;
+}
+
+// orders to soldiers that have been removed from the world are dropped;
+// they would have failed anyway.
+std::vector<SoldierAction> ReplayPlayer::readActions(WorldPtr world)
+{
+	std::vector<SoldierAction> actions;
+	unsigned int num = readVarint();
+	for(unsigned int i = 0; i < num; i++) {
+		SAType type = SAType(readByte());
+		switch(type) {
+			case SAType::Turn:
+			case SAType::Move:
+			case SAType::Shoot:
+				{
+					float x = readFloat();
+					float y = readFloat();
+					float z = readFloat();
+					actions.push_back(SoldierAction(type, Vector3(x, y, z)));
+				}
+				break;
+
+			case SAType::TurnBy:
+			case SAType::LineFormation:
+			case SAType::ColumnFormation:
+				actions.push_back(SoldierAction(type, readFloat()));
+				break;
+
+			case SAType::SwitchWeapon:
+				actions.push_back(SoldierAction(type, int(readVarint())));
+				break;
+
+			case SAType::Communication:
+				{
+					int id = readVarint();
+					SoldierPtr s = id ? world->getSoldier(id) : SoldierPtr();
+					CommunicationType comm = CommunicationType(readByte());
+					if(comm == CommunicationType::Order) {
+						OrderType order = OrderType(readByte());
+						float x = readFloat();
+						float y = readFloat();
+						float z = readFloat();
+						if(id && !s)
+							break;
+						if(order == OrderType::UnmountVehicle)
+							actions.push_back(SoldierAction(SoldierQuery(s), order));
+						else
+							actions.push_back(SoldierAction(SoldierQuery(s), order, Vector3(x, y, z)));
+					} else {
+						if(id && !s)
+							break;
+						actions.push_back(SoldierAction(SoldierQuery(s), comm));
+					}
+				}
+				break;
+
+			default:
+				actions.push_back(SoldierAction(type));
+				break;
+		}
+	}
+	return actions;
+}
+
+void ReplayPlayer::execute(AgentDirectory& agents, const SoldierActions& actions, float time)
+{
+	auto controller = agents.getControllerFor(actions.first);
+	if(!controller)
+		throw std::runtime_error("Replay: actions for a soldier without a controller");
+
+	for(auto a : actions.second) {
+		a.execute(actions.first, controller, time);
+	}
+}
+
+bool ReplayPlayer::tick(WorldPtr world, AgentDirectory& agents)
+{
+	auto getSoldier = [&] (int id) {
+		SoldierPtr s = world->getSoldier(id);
+		if(!s)
+			throw std::runtime_error("Replay: unknown soldier");
+		return s;
+	};
+
+	// events between the ticks
+	while(1) {
+		ReplayTag tag = ReplayTag(readByte());
+		if(tag == ReplayTag::End) {
+			return false;
+		} else if(tag == ReplayTag::PlayerActions) {
+			SoldierPtr s = getSoldier(readVarint());
+			execute(agents, SoldierActions(s, readActions(world)), 0.0f);
+		} else if(tag == ReplayTag::NewController) {
+			SoldierPtr s = getSoldier(readVarint());
+			agents.freeSoldier(s);
+			auto controller = SoldierControllerPtr(new SoldierController(s));
+			auto a = boost::shared_ptr<SoldierAgent>(new AI::SoldierAgent(controller));
+			agents.addAgent(s, controller, a);
+		} else if(tag == ReplayTag::TickWithTime) {
+			mTime = readFloat();
+			break;
+		} else if(tag == ReplayTag::Tick) {
+			break;
+		} else {
+			throw std::runtime_error("Replay: unexpected data");
+		}
+	}
+
+	world->update(mTime);
+	agents.updateControllers(mTime);
+
+	// the actions of the agents
+	ReplayTag tag = ReplayTag(readByte());
+	if(tag != ReplayTag::SameActionsAsPreviousTick) {
+		mPreviousTick.clear();
+		int id = 0;
+		while(tag != ReplayTag::EndOfTick) {
+			if(tag != ReplayTag::Actions && tag != ReplayTag::RepeatedActions)
+				throw std::runtime_error("Replay: unexpected data");
+
+			id += readVarint();
+			if((unsigned int)id >= mLastActions.size())
+				mLastActions.resize(id + 1);
+			if(tag == ReplayTag::Actions)
+				mLastActions[id] = readActions(world);
+			mPreviousTick.push_back(SoldierActions(getSoldier(id), mLastActions[id]));
+			tag = ReplayTag(readByte());
+		}
+	}
+
+	for(auto& a : mPreviousTick)
+		execute(agents, a, mTime);
+
+	mNumTicks++;
+	if(mIn.peek() == int(ReplayTag::Checksum)) {
+		readByte();
+		unsigned int checksum;
+		char b[sizeof(checksum)];
+		for(unsigned int i = 0; i < sizeof(checksum); i++)
+			b[i] = readByte();
+		memcpy(&checksum, b, sizeof(checksum));
+		if(checksum != stateChecksum(world)) {
+			if(mNumDesyncs == 0)
+				std::cerr << "Replay diverged from the recording at tick " << mNumTicks << ".\n";
+			mNumDesyncs++;
+		}
+	}
+
+	return true;
+}
+
+unsigned int ReplayPlayer::getNumTicks() const
+{
+	return mNumTicks;
+}
+
+unsigned int ReplayPlayer::getNumDesyncs() const
+{
+	return mNumDesyncs;
+}
+
+}
+
@@ -0,0 +1,97 @@
+#ifndef BRIGADES_REPLAY_H
+#define BRIGADES_REPLAY_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "World.h"
+#include "SoldierAction.h"
+
+namespace Brigades {
+
+class Scenario;
+class AgentDirectory;
+
+// Records the actions executed for the soldiers. The simulation is
+// deterministic, so the scenario, the random seed and the actions are
+// enough to re-simulate the battle. Actions that are the same as in the
+// previous tick are only marked as repeated, and the stream is
+// compressed. A checksum of the soldiers' state is recorded every few
+// ticks to detect diverging replays.
+class ReplayRecorder {
+	public:
+		// the world must have been created but not updated yet.
+		ReplayRecorder(std::ostream& os, const Scenario& scenario, int seed, WorldPtr world);
+		~ReplayRecorder();
+
+		// actions executed between the ticks, e.g. by the player
+		void addPlayerActions(int soldierid, const std::vector<SoldierAction>& actions);
+		// a new controller was created for the soldier
+		void newController(int soldierid);
+
+		// the actions executed by the agent directory after the world
+		// and the controllers were updated, in the order of soldier IDs
+		void startTick(float time);
+		void addActions(int soldierid, const std::vector<SoldierAction>& actions);
+		void endTick();
+
+		unsigned int getNumTicks() const;
+
+	private:
+		static void writeActions(std::string& buf, const std::vector<SoldierAction>& actions);
+
+		WorldPtr mWorld;
+		boost::iostreams::filtering_ostream mOut;
+		std::string mBetweenTicks;
+		std::string mTick;
+		std::string mPreviousTick;
+		// the encoded agent actions by soldier ID
+		std::vector<std::string> mLastActions;
+		std::string mActionBuffer;
+		float mTime = 0.0f;
+		float mPreviousTime = 0.0f;
+		int mPreviousID = 0;
+		unsigned int mNumTicks = 0;
+};
+
+// Re-simulates a recorded battle. The world and the agent directory must
+// be created from the scenario and the seed in the header, in the same
+// way as for the recording. The agents aren't run; only their
+// controllers are updated.
+class ReplayPlayer {
+	public:
+		ReplayPlayer(std::istream& is);
+		// returns false if the stream doesn't contain a replay.
+		bool readHeader(bool& arcade, bool& skirmish, int& seed, int& mapSize);
+		// re-simulates the next tick. Returns false at the end of the
+		// replay; throws std::runtime_error if the replay is broken.
+		bool tick(WorldPtr world, AgentDirectory& agents);
+		unsigned int getNumTicks() const;
+		// the number of checksums that didn't match the recording
+		unsigned int getNumDesyncs() const;
+
+	private:
+		typedef std::pair<SoldierPtr, std::vector<SoldierAction>> SoldierActions;
+
+		unsigned char readByte();
+		unsigned int readVarint();
+		float readFloat();
+		std::vector<SoldierAction> readActions(WorldPtr world);
+		void execute(AgentDirectory& agents, const SoldierActions& actions, float time);
+
+		std::istream& mSource;
+		boost::iostreams::filtering_istream mIn;
+		std::vector<SoldierActions> mPreviousTick;
+		std::vector<std::vector<SoldierAction>> mLastActions;
+		float mTime = 0.0f;
+		unsigned int mNumTicks = 0;
+		unsigned int mNumDesyncs = 0;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,513 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/base_object.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/list.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/utility.hpp>
+#include <boost/serialization/split_free.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+#include "Savegame.h"
+#include "Scenario.h"
+#include "World.h"
+#include "Soldier.h"
+#include "SensorySystem.h"
+#include "SoldierController.h"
+#include "AgentDirectory.h"
+#include "ai/SoldierAgent.h"
+
+// the libcommon types are serialized non-intrusively.
+namespace boost {
+
+namespace serialization {
+
+template<class Archive>
+void serialize(Archive& ar, Common::Vector3& v, const unsigned int version)
+{
+	ar & v.x & v.y & v.z;
+}
+
+template<class Archive>
+void save(Archive& ar, const Common::Countdown& c, const unsigned int version)
+{
+	float max = c.getMaxTime();
+	float left = c.timeLeft();
+	bool running = c.running();
+	ar & max & left & running;
+}
+
+template<class Archive>
+void load(Archive& ar, Common::Countdown& c, const unsigned int version)
+{
+	float max, left;
+	bool running;
+	ar & max & left & running;
+	c = Common::Countdown(max);
+	if(running) {
+		c.rewind();
+		c.doCountdown(max - left);
+	} else {
+		c.clear();
+	}
+}
+
+}
+
+}
+
+BOOST_SERIALIZATION_SPLIT_FREE(Common::Countdown)
+BOOST_CLASS_IMPLEMENTATION(Common::Vector3, boost::serialization::object_serializable)
+BOOST_CLASS_TRACKING(Common::Vector3, boost::serialization::track_never)
+
+using namespace Common;
+
+template<class Archive>
+void Side::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mFirst;
+}
+
+namespace Brigades {
+
+// the world being loaded, for the objects that refer to it
+static WorldPtr LoadingWorld;
+
+static const char savegameMagic[] = "BRIGADES";
+static const char savegameVersion = 2;
+
+// position, movement and heading; the other attributes of the vehicles
+// don't change after construction.
+template<class Archive>
+static void serializeVehicle(Archive& ar, Vehicle& v)
+{
+	Vector3 pos = v.getPosition();
+	Vector3 vel = v.getVelocity();
+	Vector3 acc = v.getAcceleration();
+	float rot = v.getXYRotation();
+	float maxspeed = v.getMaxSpeed();
+	ar & pos & vel & acc & rot & maxspeed;
+	if(Archive::is_loading::value) {
+		v.setPosition(pos);
+		v.setVelocity(vel);
+		v.setAcceleration(acc);
+		v.setXYRotation(rot);
+		v.setMaxSpeed(maxspeed);
+	}
+}
+
+template<class Archive>
+void WeaponType::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mName & mRange & mVelocity & mLoadTime & mVariation & mSpeedVariates;
+	ar & mSoftDamage & mLightArmorDamage & mHeavyArmorDamage;
+}
+
+template<class Archive>
+void Weapon::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mWeapon & mLoading;
+}
+
+template<class Archive>
+void Armor::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mID & mSide & mHealth & mOccupied & mFreeSeats;
+	serializeVehicle(ar, *this);
+}
+
+template<class Archive>
+void AttackOrder::serialize(Archive& ar, const unsigned int version)
+{
+	ar & CenterPoint & DefenseLineToRight;
+}
+
+template<class Archive>
+void Soldier::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mSide & mID & mFOV & mAlive & mWeapons & mBackupWeapons & mCurrentWeaponIndex;
+	ar & mSensorySystem & mRank & mCommandees & mLeader & mHealth & mDictator;
+	ar & mFatigue & mHunger & mFoodPacks & mSleepTime & mEatTime;
+	ar & mFormationOffset & mDefendPosition & mAttacking & mAttackOrder;
+	ar & mName & mEnemyContact & mEnemyContactTimer & mMountPoint & mDriving;
+	serializeVehicle(ar, *this);
+	if(Archive::is_loading::value)
+		mWorld = LoadingWorld;
+}
+
+// the maps are ordered by address, so they're saved ordered by ID to
+// always save the same state the same way.
+template<class Archive, typename T>
+static void serializeByID(Archive& ar, std::map<T, float>& m)
+{
+	std::vector<std::pair<T, float>> v(m.begin(), m.end());
+	std::sort(v.begin(), v.end(), [] (const std::pair<T, float>& p1, const std::pair<T, float>& p2) {
+			return p1.first->getID() < p2.first->getID();
+			});
+	ar & v;
+	if(Archive::is_loading::value)
+		m.insert(v.begin(), v.end());
+}
+
+template<class Archive>
+void SensorySystem::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mSoldier;
+	serializeByID(ar, mSoldiers);
+	serializeByID(ar, mArmors);
+}
+
+template<class Archive>
+void CircleTriggerRegion::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mCenter & mRadius;
+}
+
+template<class Archive>
+void TimedTrigger::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mTimer;
+}
+
+template<class Archive>
+void WeaponPickupTrigger::serialize(Archive& ar, const unsigned int version)
+{
+	ar & boost::serialization::base_object<TimedTrigger>(*this);
+	ar & mWeapon & mRegion & mPickedUp & mName;
+}
+
+// weapon pickups are the only triggers that stay in the system.
+template<class Archive>
+void TriggerSystem::serialize(Archive& ar, const unsigned int version)
+{
+	std::vector<WeaponPickupTriggerPtr> triggers;
+	if(Archive::is_saving::value) {
+		for(auto& t : mTriggers) {
+			auto p = boost::dynamic_pointer_cast<WeaponPickupTrigger>(t);
+			assert(p);
+			triggers.push_back(p);
+		}
+	}
+
+	ar & triggers;
+
+	if(Archive::is_loading::value) {
+		for(auto& t : triggers)
+			add(t);
+	}
+}
+
+template<class Archive>
+void Event::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mType & mSoundMaker & mWeapon;
+}
+
+// only the events that haven't been handled yet are saved.
+template<class Archive>
+void EventQueue::serialize(Archive& ar, const unsigned int version)
+{
+	unsigned int num = 0;
+	for(unsigned int id = 0; id < mHeads.size(); id++) {
+		for(int i = mHeads[id]; i != -1; i = mEntries[i].next)
+			num++;
+	}
+
+	ar & num;
+
+	if(Archive::is_saving::value) {
+		for(int id = 0; id < int(mHeads.size()); id++) {
+			for(int i = mHeads[id]; i != -1; i = mEntries[i].next) {
+				ar & id & mEntries[i].event;
+			}
+		}
+	} else {
+		for(unsigned int i = 0; i < num; i++) {
+			int id;
+			Event e;
+			ar & id & e;
+			add(id, e);
+		}
+	}
+}
+
+template<class Archive>
+void BulletStore::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mSize;
+
+	if(Archive::is_loading::value) {
+		mPositions.resize(mSize);
+		mVelocities.resize(mSize);
+		mTimeLeft.resize(mSize);
+		mFlyTime.resize(mSize);
+		mShooterSides.resize(mSize);
+		mOriginalSpeeds.resize(mSize);
+		mWeapons.resize(mSize);
+		mObstacleCaches.resize(mSize);
+	}
+
+	for(unsigned int i = 0; i < mSize; i++) {
+		ar & mPositions[i] & mVelocities[i] & mTimeLeft[i] & mFlyTime[i];
+		ar & mShooterSides[i] & mOriginalSpeeds[i] & mWeapons[i];
+	}
+
+	if(Archive::is_loading::value) {
+		for(unsigned int i = 0; i < mSize; i++)
+			mGrid.add(i, mPositions[i]);
+	}
+}
+
+// the trees and roads are saved as flat arrays of their coordinates,
+// which the archive writes as a block. The trees of streamed terrain are
+// created again from the seed around the units.
+template<class Archive>
+void Terrain::serialize(Archive& ar, const unsigned int version)
+{
+	std::vector<float> trees;
+	std::vector<float> roads;
+
+	if(Archive::is_saving::value) {
+		float radius = std::max(mWidth, mHeight);
+		if(!mStreamed) {
+			for(auto t : getTreesAt(Vector3(0.0f, 0.0f, 0.0f), radius)) {
+				trees.insert(trees.end(), { t->getPosition().x, t->getPosition().y, t->getRadius() });
+			}
+		}
+		for(auto r : getRoadsAt(Vector3(0.0f, 0.0f, 0.0f), radius)) {
+			roads.insert(roads.end(), { r->getStart().x, r->getStart().y,
+					r->getEnd().x, r->getEnd().y });
+		}
+	}
+
+	ar & mStreamed & mSeed & mStart & mEnd & trees & roads;
+
+	if(Archive::is_loading::value) {
+		for(unsigned int i = 0; i + 2 < trees.size(); i += 3)
+			addTree(Vector3(trees[i], trees[i + 1], 0.0f), trees[i + 2]);
+		for(unsigned int i = 0; i + 3 < roads.size(); i += 4)
+			addRoad(Vector3(roads[i], roads[i + 1], 0.0f), Vector3(roads[i + 2], roads[i + 3], 0.0f));
+		if(!mStreamed)
+			buildOcclusionMap();
+	}
+}
+
+template<class Archive>
+void Timestamp::serialize(Archive& ar, const unsigned int version)
+{
+	ar & Day & Hour & Minute & Second & Millisecond;
+}
+
+// the soldiers and armors refer to each other, to the world and to the
+// weapons, and are saved through their shared pointers so that each is
+// saved once. The walls and the caches are rebuilt after loading.
+template<class Archive>
+void World::serialize(Archive& ar, const unsigned int version)
+{
+	if(Archive::is_loading::value)
+		LoadingWorld = shared_from_this();
+
+	int lastSoldierID = Soldier::getLastID();
+	int lastArmorID = Armor::getLastID();
+	std::vector<SoldierPtr> soldiers(mSoldiers.begin(), mSoldiers.end());
+	std::vector<ArmorPtr> armors(mArmors.begin(), mArmors.end());
+	std::vector<std::pair<Vector3, float>> foxholes;
+
+	if(Archive::is_saving::value) {
+		for(auto f : getFoxholesAt(Vector3(0.0f, 0.0f, 0.0f), std::max(getWidth(), getHeight())))
+			foxholes.push_back(std::make_pair(f->getPosition(), f->getDepth()));
+	}
+
+	ar & lastSoldierID & lastArmorID;
+	ar & mTerrain & mSides & soldiers & armors & foxholes & mBullets;
+	ar & mTeamWon & mSoldiersAlive & mSoldiersAtStart & mRootLeader;
+	ar & mTriggerSystem & mEventQueue & mPendingVisionUpdates & mPendingSounds;
+	ar & mTime & mReinforcementTimer;
+
+	if(Archive::is_loading::value) {
+		Soldier::setLastID(lastSoldierID);
+		Armor::setLastID(lastArmorID);
+
+		for(auto& s : soldiers) {
+			mSoldierGrid.add(s, s->getPosition());
+			mMaxVehicleRadius = std::max(mMaxVehicleRadius, s->getRadius());
+			mSoldiers.insert(s->getID(), s);
+		}
+
+		// the known enemies and the positions of the units aren't saved
+		for(auto& s : soldiers) {
+			for(auto& e : s->getSensorySystem()->getSoldiers())
+				s->soldierSensed(e);
+		}
+		updateUnitPositions();
+
+		for(auto& a : armors) {
+			mArmorGrid.add(a, a->getPosition());
+			mMaxVehicleRadius = std::max(mMaxVehicleRadius, a->getRadius());
+			mArmors.insert(a->getID(), a);
+		}
+
+		for(auto& f : foxholes) {
+			Foxhole* foxhole = new Foxhole(shared_from_this(), f.first);
+			foxhole->deepen(f.second);
+			mFoxholes.insert(foxhole, Vector2(f.first.x, f.first.y));
+		}
+
+		if(mTerrain.isStreamed())
+			updateTerrainRegions();
+
+		for(unsigned int i = 0; i < mBullets.size(); i++)
+			buildObstacleCache(i, mBullets.getTimeLeft(i));
+
+		addWalls();
+		updateVisibility();
+		LoadingWorld.reset();
+	}
+}
+
+template<class Archive>
+void SoldierQuery::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mSoldier;
+}
+
+// the data is the target position of the goto and mount orders.
+template<class Archive>
+void SoldierCommunication::serialize(Archive& ar, const unsigned int version)
+{
+	ar & from & comm & order;
+
+	bool hasData = data != nullptr;
+	ar & hasData;
+	if(hasData) {
+		Vector3 pos;
+		if(Archive::is_saving::value)
+			pos = *(Vector3*)data;
+		ar & pos;
+		if(Archive::is_loading::value)
+			data = (void*)new Vector3(pos);
+	}
+}
+
+template<class Archive>
+void SoldierController::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mCommunications & mMovementSoundTimer & mDriverSteering;
+	if(Archive::is_loading::value)
+		updateObstacleCache();
+}
+
+template<class Archive>
+void AI::SoldierAgent::serialize(Archive& ar, const unsigned int version)
+{
+	ar & mMoveTarget & mMountTarget & mWantUnmount;
+}
+
+template<class Archive>
+void AgentDirectory::serialize(Archive& ar, const unsigned int version)
+{
+	unsigned int num = mAgents.size();
+	ar & num;
+
+	if(Archive::is_saving::value) {
+		std::vector<SoldierPtr> soldiers;
+		for(auto& p : mAgents)
+			soldiers.push_back(p.first);
+
+		std::sort(soldiers.begin(), soldiers.end(),
+				[] (const SoldierPtr& s1, const SoldierPtr& s2) {
+				return s1->getID() < s2->getID();
+				});
+
+		for(auto& s : soldiers) {
+			auto& p = mAgents[s];
+			auto agent = boost::dynamic_pointer_cast<AI::SoldierAgent>(p.second);
+			bool ai = agent != nullptr;
+			ar & s & *p.first & ai;
+			if(ai)
+				ar & *agent;
+		}
+	} else {
+		for(unsigned int i = 0; i < num; i++) {
+			SoldierPtr s;
+			bool ai;
+			ar & s;
+			soldierAdded(s);
+			auto& p = mAgents[s];
+			ar & *p.first & ai;
+			if(ai) {
+				auto agent = boost::dynamic_pointer_cast<AI::SoldierAgent>(p.second);
+				assert(agent);
+				ar & *agent;
+			}
+		}
+	}
+}
+
+namespace Savegame {
+
+bool readHeader(std::istream& is, bool& arcade, bool& skirmish, int& mapSize)
+{
+	char magic[sizeof(savegameMagic)];
+	char header[3];
+	char sizebuf[sizeof(mapSize)];
+	is.read(magic, sizeof(magic));
+	is.read(header, sizeof(header));
+	is.read(sizebuf, sizeof(sizebuf));
+	if(!is || memcmp(magic, savegameMagic, sizeof(magic)) || header[0] != savegameVersion)
+		return false;
+
+	arcade = header[1];
+	skirmish = header[2];
+	memcpy(&mapSize, sizebuf, sizeof(mapSize));
+	return true;
+}
+
+void save(std::ostream& os, const Scenario& scenario,
+		const World& world, const AgentDirectory& agents)
+{
+	char header[3] = { savegameVersion, scenario.isArcade(), scenario.isSkirmish() };
+	int mapSize = scenario.getMapSize();
+	char sizebuf[sizeof(mapSize)];
+	memcpy(sizebuf, &mapSize, sizeof(mapSize));
+	os.write(savegameMagic, sizeof(savegameMagic));
+	os.write(header, sizeof(header));
+	os.write(sizebuf, sizeof(sizebuf));
+
+	// best_speed compresses the state to a fraction of its size at
+	// several times the speed of the default level.
+	boost::iostreams::filtering_ostream out;
+	out.push(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed));
+	out.push(os);
+	{
+		boost::archive::binary_oarchive oa(out);
+		oa << world << agents;
+	}
+}
+
+WorldPtr load(std::istream& is, const Scenario& scenario, AgentDirectory& agents)
+{
+	WorldPtr world = scenario.createWorld(0, false);
+
+	boost::iostreams::filtering_istream in;
+	in.push(boost::iostreams::zlib_decompressor());
+	in.push(is);
+	{
+		boost::archive::binary_iarchive ia(in);
+		ia >> *world >> agents;
+	}
+
+	return world;
+}
+
+}
+
+}
+
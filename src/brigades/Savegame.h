@@ -0,0 +1,35 @@
+#ifndef BRIGADES_SAVEGAME_H
+#define BRIGADES_SAVEGAME_H
+
+#include <iostream>
+
+#include "World.h"
+
+namespace Brigades {
+
+class Scenario;
+class AgentDirectory;
+
+// Saved games: a small header with the scenario settings followed by the
+// state of the world and the AI agents as a zlib compressed boost binary
+// archive. The binary archive is not portable between platforms.
+namespace Savegame {
+
+// reads the scenario settings of a saved game. Returns false if the
+// stream doesn't contain a saved game.
+bool readHeader(std::istream& is, bool& arcade, bool& skirmish, int& mapSize);
+
+void save(std::ostream& os, const Scenario& scenario,
+		const World& world, const AgentDirectory& agents);
+
+// the header must have been read and the scenario created based on it.
+// The loaded soldiers are added to the agent directory, which should be
+// empty.
+WorldPtr load(std::istream& is, const Scenario& scenario, AgentDirectory& agents);
+
+}
+
+}
+
+#endif
+
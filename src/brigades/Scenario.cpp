@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cassert>
+
+#include "Scenario.h"
+
+namespace Brigades {
+
+Scenario::Scenario(bool arcade, bool skirmish)
+	: mArcade(arcade),
+	mSkirmish(skirmish),
+	mUnitSize(UnitSize::Company)
+{
+	if(arcade) {
+		mArmory = new ArcadeArmory();
+		mVisibility = 30.0f;
+		mSoundDistance = 50.0f;
+		if(skirmish) {
+			mWidth = 256.0f;
+			mHeight = 256.0f;
+			mUnitSize = UnitSize::Squad;
+		} else {
+			mWidth = 512.0f;
+			mHeight = 512.0f;
+		}
+	} else {
+		mArmory = new SimulationArmory();
+		mVisibility = 200.0f;
+		mSoundDistance = 300.0f;
+		if(skirmish) {
+			mWidth = 512.0f;
+			mHeight = 512.0f;
+			mUnitSize = UnitSize::Squad;
+		} else {
+			mWidth = 1536.0f;
+			mHeight = 1536.0f;
+		}
+	}
+}
+
+Scenario::~Scenario()
+{
+	delete mArmory;
+}
+
+// the world refers to the armory of the scenario, so the scenario
+// must outlive it.
+WorldPtr Scenario::createWorld(int seed, bool generateTerrain) const
+{
+	static const float maxGeneratedSize = 4096.0f;
+	TerrainMode mode = TerrainMode::Empty;
+	if(generateTerrain) {
+		if(std::max(mWidth, mHeight) > maxGeneratedSize)
+			mode = TerrainMode::Streamed;
+		else
+			mode = TerrainMode::Generated;
+	}
+	return WorldPtr(new World(mWidth, mHeight, mVisibility, mSoundDistance,
+				mUnitSize, mUnitSize == UnitSize::Company, *mArmory,
+				seed, mode));
+}
+
+void Scenario::setMapSize(int size)
+{
+	assert(size > 0 && size % 128 == 0);
+	mWidth = size;
+	mHeight = size;
+}
+
+int Scenario::getMapSize() const
+{
+	return mWidth;
+}
+
+bool Scenario::isArcade() const
+{
+	return mArcade;
+}
+
+bool Scenario::isSkirmish() const
+{
+	return mSkirmish;
+}
+
+}
+
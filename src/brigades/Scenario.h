@@ -0,0 +1,39 @@
+#ifndef BRIGADES_SCENARIO_H
+#define BRIGADES_SCENARIO_H
+
+#include "World.h"
+#include "Armory.h"
+
+namespace Brigades {
+
+// battle setup shared by the interactive and the headless binaries.
+class Scenario {
+	public:
+		Scenario(bool arcade, bool skirmish);
+		~Scenario();
+		// the terrain is generated from the seed. Without generating
+		// the terrain, e.g. for loading a saved game, the seed is unused.
+		WorldPtr createWorld(int seed, bool generateTerrain = true) const;
+		// overrides the width and height of the map. The size must be a
+		// multiple of 128. The trees of maps larger than 4 km are
+		// streamed in around the units.
+		void setMapSize(int size);
+		int getMapSize() const;
+		bool isArcade() const;
+		bool isSkirmish() const;
+
+	private:
+		bool mArcade;
+		bool mSkirmish;
+		Armory* mArmory;
+		float mWidth;
+		float mHeight;
+		float mVisibility;
+		float mSoundDistance;
+		UnitSize mUnitSize;
+};
+
+}
+
+#endif
+
@@ -1,4 +1,5 @@
 #include "SensorySystem.h"
+#include "Profiler.h"
 
 namespace Brigades {
 
@@ -12,10 +13,17 @@ SensorySystem::SensorySystem(SoldierPtr s)
 {
 }
 
+// for loading saved games
+SensorySystem::SensorySystem()
+	: mVisionUpdater(VISION_UPDATE_TIME),
+	mFoxholesUpdated(false)
+{
+}
+
 bool SensorySystem::update(float time)
 {
 	if(mVisionUpdater.check(time)) {
-		updateFOV();
+		mSoldier->getWorld()->requestVisionUpdate(mSoldier);
 		return true;
 	}
 	return false;
@@ -48,20 +56,27 @@ const std::vector<Foxhole*>& SensorySystem::getFoxholes() const
 	return mFoxholes;
 }
 
-void SensorySystem::updateFOV()
+void SensorySystem::updateFOV(const std::vector<SoldierPtr>& currentSoldiers,
+		const std::vector<ArmorPtr>& currentArmors)
 {
-	{
-		auto currentSoldiers = mSoldier->getWorld()->getSoldiersInFOV(mSoldier);
+	ProfileScope profile(ProfileSection::SensorySystem);
 
-		// add new soldiers and reset time for previous ones
+	{
+		// add new soldiers and reset time for previous ones. The
+		// changes are passed on to the unit of the soldier.
 		for(auto& s : currentSoldiers) {
-			mSoldiers[s] = 0.0f;
+			auto ins = mSoldiers.insert(std::make_pair(s, 0.0f));
+			if(ins.second)
+				mSoldier->soldierSensed(s);
+			else
+				ins.first->second = 0.0f;
 		}
 
 		for(auto it = mSoldiers.begin(); it != mSoldiers.end(); ) {
 			it->second += VISION_UPDATE_TIME;
 			if(it->second > RECOLLECTION_TIME) {
 				// erase entry
+				mSoldier->soldierForgotten(it->first);
 				it = mSoldiers.erase(it);
 			} else {
 				// continue
@@ -71,8 +86,6 @@ void SensorySystem::updateFOV()
 	}
 
 	{
-		auto currentArmors = mSoldier->getWorld()->getArmorsInFOV(mSoldier);
-
 		// add new soldiers and reset time for previous ones
 		for(auto& s : currentArmors) {
 			mArmors[s] = 0.0f;
@@ -96,7 +109,11 @@ void SensorySystem::updateFOV()
 
 void SensorySystem::addSound(SoldierPtr s)
 {
-	mSoldiers[s] = 0.0f;
+	auto ins = mSoldiers.insert(std::make_pair(s, 0.0f));
+	if(ins.second)
+		mSoldier->soldierSensed(s);
+	else
+		ins.first->second = 0.0f;
 }
 
 void SensorySystem::addSound(ArmorPtr s)
@@ -106,6 +123,8 @@ void SensorySystem::addSound(ArmorPtr s)
 
 void SensorySystem::clear()
 {
+	for(auto& s : mSoldiers)
+		mSoldier->soldierForgotten(s.first);
 	mSoldiers.clear();
 	mArmors.clear();
 	mFoxholes.clear();
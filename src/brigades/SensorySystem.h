@@ -4,6 +4,7 @@
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/Clock.h"
 
@@ -22,9 +23,15 @@ class SensorySystem {
 		void addSound(SoldierPtr s);
 		void addSound(ArmorPtr p);
 		void clear();
+		// called by the world with what the soldier currently sees
+		void updateFOV(const std::vector<SoldierPtr>& currentSoldiers,
+				const std::vector<ArmorPtr>& currentArmors);
 
 	private:
-		void updateFOV();
+		friend class boost::serialization::access;
+		SensorySystem();
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
 
 		SoldierPtr mSoldier;
 		Common::SteadyTimer mVisionUpdater;
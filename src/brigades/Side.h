@@ -2,6 +2,7 @@
 #define BRIGADES_SIDE_H
 
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 class Side {
 	public:
@@ -10,6 +11,11 @@ class Side {
 		int getSideNum() const;
 
 	private:
+		friend class boost::serialization::access;
+		Side() { }
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		bool mFirst;
 };
 
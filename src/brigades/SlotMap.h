@@ -0,0 +1,119 @@
+#ifndef BRIGADES_SLOTMAP_H
+#define BRIGADES_SLOTMAP_H
+
+#include <vector>
+#include <climits>
+#include <cassert>
+
+namespace Brigades {
+
+// Values stored contiguously and looked up by an integer ID. The IDs are
+// the handles to the values; they never change and are not reused, so
+// they must be added in increasing order. Iteration is in ID order.
+template<typename T>
+class SlotMap {
+	public:
+		typedef typename std::vector<T>::iterator iterator;
+		typedef typename std::vector<T>::const_iterator const_iterator;
+
+		void insert(int id, const T& t);
+		T* find(int id);
+		const T* find(int id) const;
+		unsigned int size() const;
+		bool empty() const;
+		const std::vector<T>& values() const;
+
+		iterator begin() { return mValues.begin(); }
+		iterator end() { return mValues.end(); }
+		const_iterator begin() const { return mValues.begin(); }
+		const_iterator end() const { return mValues.end(); }
+
+		// removes the values for which pred(t) is true, moving the rest
+		// down to close the gaps.
+		template<typename F>
+		void removeIf(F pred);
+
+	private:
+		static const unsigned int invalidIndex = UINT_MAX;
+
+		std::vector<T> mValues;
+		std::vector<int> mIDs;
+		// index to mValues for each ID
+		std::vector<unsigned int> mIndices;
+};
+
+template<typename T>
+const unsigned int SlotMap<T>::invalidIndex;
+
+template<typename T>
+void SlotMap<T>::insert(int id, const T& t)
+{
+	assert(id >= 0);
+	assert(mIDs.empty() || id > mIDs.back());
+	if((unsigned int)id >= mIndices.size())
+		mIndices.resize(id + 1, invalidIndex);
+	mIndices[id] = mValues.size();
+	mValues.push_back(t);
+	mIDs.push_back(id);
+}
+
+template<typename T>
+T* SlotMap<T>::find(int id)
+{
+	if(id < 0 || (unsigned int)id >= mIndices.size() || mIndices[id] == invalidIndex)
+		return nullptr;
+	return &mValues[mIndices[id]];
+}
+
+template<typename T>
+const T* SlotMap<T>::find(int id) const
+{
+	if(id < 0 || (unsigned int)id >= mIndices.size() || mIndices[id] == invalidIndex)
+		return nullptr;
+	return &mValues[mIndices[id]];
+}
+
+template<typename T>
+unsigned int SlotMap<T>::size() const
+{
+	return mValues.size();
+}
+
+template<typename T>
+bool SlotMap<T>::empty() const
+{
+	return mValues.empty();
+}
+
+template<typename T>
+const std::vector<T>& SlotMap<T>::values() const
+{
+	return mValues;
+}
+
+template<typename T>
+template<typename F>
+void SlotMap<T>::removeIf(F pred)
+{
+	unsigned int j = 0;
+	for(unsigned int i = 0; i < mValues.size(); i++) {
+		if(pred(mValues[i])) {
+			mIndices[mIDs[i]] = invalidIndex;
+			continue;
+		}
+
+		if(i != j) {
+			mValues[j] = mValues[i];
+			mIDs[j] = mIDs[i];
+			mIndices[mIDs[j]] = j;
+		}
+		j++;
+	}
+	mValues.resize(j);
+	mIDs.resize(j);
+}
+
+}
+
+#endif
+
@@ -1,3 +1,6 @@
+#include <cassert>
+#include <algorithm>
+
 #include <string.h>
 
 #include "common/Color.h"
@@ -41,6 +44,22 @@ Soldier::Soldier(boost::shared_ptr<World> w, bool firstside, SoldierRank rank)
 	mRotation = 0.1f;
 }
 
+// for loading saved games
+Soldier::Soldier()
+	: Common::Vehicle(0.5f, 10.0f, 100.0f),
+	mID(0),
+	mFOV(PI),
+	mAlive(true),
+	mCurrentWeaponIndex(0),
+	mRank(SoldierRank::Private),
+	mHealth(1.0f),
+	mDictator(false),
+	mAttacking(false),
+	mEnemyContact(false),
+	mEnemyContactTimer(1.0f)
+{
+}
+
 void Soldier::init()
 {
 	mSensorySystem = SensorySystemPtr(new SensorySystem(shared_from_this()));
@@ -61,10 +80,21 @@ int Soldier::getSideNum() const
 	return mSide->getSideNum();
 }
 
+static int LastSoldierID = 0;
+
 int Soldier::getNextID()
 {
-	static int id = 0;
-	return ++id;
+	return ++LastSoldierID;
+}
+
+int Soldier::getLastID()
+{
+	return LastSoldierID;
+}
+
+void Soldier::setLastID(int id)
+{
+	LastSoldierID = id;
 }
 
 std::string Soldier::generateName()
@@ -347,16 +377,23 @@ WorldPtr Soldier::getWorld()
 
 Common::Vector3 Soldier::getUnitPosition() const
 {
-	if(mCommandees.size() == 0) {
+	if(mCommandees.size() == 0)
 		return getPosition();
-	} else {
-		Vector3 midp;
-		for(auto& c : mCommandees) {
-			midp += c->getUnitPosition();
-		}
-		midp /= mCommandees.size();
-		return midp;
+	else
+		return mUnitPosition;
+}
+
+void Soldier::updateUnitPosition()
+{
+	if(mCommandees.size() == 0)
+		return;
+
+	Vector3 midp;
+	for(auto& c : mCommandees) {
+		c->updateUnitPosition();
+		midp += c->getUnitPosition();
 	}
+	mUnitPosition = midp / mCommandees.size();
 }
 
 const SensorySystemPtr Soldier::getSensorySystem() const
@@ -369,39 +406,85 @@ SensorySystemPtr Soldier::getSensorySystem()
 	return mSensorySystem;
 }
 
-std::set<SoldierPtr> Soldier::getKnownEnemySoldiers() const
+const std::set<SoldierPtr>& Soldier::getKnownEnemySoldiers() const
 {
-	std::set<SoldierPtr> ret;
-	std::vector<SoldierPtr> mySeen = mSensorySystem->getSoldiers();
-	ret.insert(mySeen.begin(), mySeen.end());
-	for(auto& c : mCommandees) {
-		auto res = c->getKnownEnemySoldiers();
-		ret.insert(res.begin(), res.end());
-	}
-	return ret;
+	return mKnownEnemies;
 }
 
-void Soldier::addEvent(EventPtr e)
+unsigned int Soldier::getKnownEnemySoldiersVersion() const
 {
-	mEvents.push_back(e);
+	return mKnownEnemiesVersion;
 }
 
-std::vector<EventPtr>& Soldier::getEvents()
+void Soldier::soldierSensed(const SoldierPtr& s)
 {
-	return mEvents;
+	addKnownEnemy(s, 1);
 }
 
-bool Soldier::handleEvents()
+void Soldier::soldierForgotten(const SoldierPtr& s)
+{
+	addKnownEnemy(s, -1);
+}
+
+// adds the count to the soldier and its leaders. The command tree is
+// only a few levels deep.
+void Soldier::addKnownEnemy(const SoldierPtr& s, int count)
+{
+	for(Soldier* l = this; l; l = l->mLeader.get()) {
+		int& c = l->mKnownEnemyCounts[s];
+		int prev = c;
+		c += count;
+		assert(c >= 0);
+		if(prev == 0 && c > 0) {
+			l->mKnownEnemies.insert(s);
+			l->mKnownEnemiesVersion++;
+		} else if(c == 0) {
+			l->mKnownEnemyCounts.erase(s);
+			l->mKnownEnemies.erase(s);
+			l->mKnownEnemiesVersion++;
+		}
+	}
+}
+
+// adds or removes the known enemies of a commandee's unit
+void Soldier::addKnownEnemies(const Soldier& commandee, int sign)
+{
+	for(auto& e : commandee.mKnownEnemyCounts)
+		addKnownEnemy(e.first, e.second * sign);
+}
+
+// the commandees of the soldier changed - the positions of the
+// subunits are still valid
+void Soldier::updateLeaderUnitPositions()
 {
-	bool ret = !mEvents.empty();
+	for(Soldier* s = this; s; s = s->mLeader.get()) {
+		if(s->mCommandees.empty())
+			continue;
 
-	for(auto e : mEvents) {
-		e->handleEvent(shared_from_this());
+		Vector3 midp;
+		for(auto& c : s->mCommandees)
+			midp += c->getUnitPosition();
+		s->mUnitPosition = midp / s->mCommandees.size();
 	}
+}
+
+void Soldier::addEvent(const Event& e)
+{
+	mWorld->getEventQueue().add(mID, e);
+}
 
-	mEvents.clear();
+bool Soldier::handleEvents()
+{
+	auto& queue = mWorld->getEventQueue();
+	if(!queue.hasEvents(mID))
+		return false;
 
-	return ret;
+	auto p = shared_from_this();
+	queue.handle(mID, [&] (const Event& e) {
+			e.handleEvent(p);
+			});
+
+	return true;
 }
 
 SoldierRank Soldier::getRank() const
@@ -419,13 +502,20 @@ void Soldier::addCommandee(SoldierPtr s)
 	if(!isDead() && !s->isDead()) {
 		mCommandees.push_back(s);
 		s->setLeader(shared_from_this());
+		addKnownEnemies(*s, 1);
+		updateLeaderUnitPositions();
 	}
 }
 
 void Soldier::removeCommandee(SoldierPtr s)
 {
-	mCommandees.remove(s);
+	auto it = std::find(mCommandees.begin(), mCommandees.end(), s);
+	if(it != mCommandees.end()) {
+		mCommandees.erase(it);
+		addKnownEnemies(*s, -1);
+	}
 	s->setLeader(SoldierPtr());
+	updateLeaderUnitPositions();
 }
 
 const std::list<SoldierPtr>& Soldier::getCommandees() const
@@ -433,9 +523,12 @@ const std::list<SoldierPtr>& Soldier::getCommandees() const
 	return mCommandees;
 }
 
-std::list<SoldierPtr>& Soldier::getCommandees()
+void Soldier::clearCommandees()
 {
-	return mCommandees;
+	for(auto& c : mCommandees)
+		addKnownEnemies(*c, -1);
+	mCommandees.clear();
+	updateLeaderUnitPositions();
 }
 
 void Soldier::setLeader(SoldierPtr s)
@@ -511,7 +604,9 @@ void Soldier::pruneCommandees()
 	auto sit = mCommandees.begin();
 	while(sit != mCommandees.end()) {
 		if((*sit)->isDead()) {
+			addKnownEnemies(**sit, -1);
 			sit = mCommandees.erase(sit);
+			updateLeaderUnitPositions();
 		}
 		else {
 			++sit;
@@ -4,9 +4,11 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <map>
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/Vehicle.h"
 #include "common/Steering.h"
@@ -41,6 +43,9 @@ struct AttackOrder {
 	AttackOrder(const Common::Vector3& p, const Common::Vector3& d, float width);
 	Common::Vector3 CenterPoint;
 	Common::Vector3 DefenseLineToRight;
+
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int version);
 };
 
 
@@ -70,19 +75,28 @@ class Soldier : public Common::Vehicle, public boost::enable_shared_from_this<So
 		const std::vector<WeaponPtr>& getWeapons() const;
 		const boost::shared_ptr<World> getWorld() const;
 		Common::Vector3 getUnitPosition() const;
+		// computes the positions of the unit led by the soldier and
+		// of its subunits. Called by the world after the soldiers moved.
+		void updateUnitPosition();
 		boost::shared_ptr<World> getWorld();
 		const boost::shared_ptr<SensorySystem> getSensorySystem() const;
 		boost::shared_ptr<SensorySystem> getSensorySystem();
-		std::set<SoldierPtr> getKnownEnemySoldiers() const;
-		void addEvent(EventPtr e);
-		std::vector<EventPtr>& getEvents();
+		// the soldiers sensed by the soldier or anyone in its unit
+		const std::set<SoldierPtr>& getKnownEnemySoldiers() const;
+		// changes whenever the known enemy soldiers change
+		unsigned int getKnownEnemySoldiersVersion() const;
+		// called by the sensory system when it starts and stops sensing
+		// a soldier
+		void soldierSensed(const SoldierPtr& s);
+		void soldierForgotten(const SoldierPtr& s);
+		void addEvent(const Event& e);
 		bool handleEvents();
 		SoldierRank getRank() const;
 		void setRank(SoldierRank r);
 		void addCommandee(SoldierPtr s);
 		void removeCommandee(SoldierPtr s);
-		std::list<SoldierPtr>& getCommandees();
 		const std::list<SoldierPtr>& getCommandees() const;
+		void clearCommandees();
 		void setLeader(SoldierPtr s);
 		SoldierPtr getLeader();
 		const SoldierPtr getLeader() const;
@@ -102,6 +116,9 @@ class Soldier : public Common::Vehicle, public boost::enable_shared_from_this<So
 		bool hasEnemyContact() const;
 		const std::string& getName() const;
 		static const char* rankToString(SoldierRank r);
+		// the ID of the latest soldier, for saved games
+		static int getLastID();
+		static void setLastID(int id);
 
 		bool sleeping() const;
 		bool eating() const;
@@ -133,9 +150,17 @@ class Soldier : public Common::Vehicle, public boost::enable_shared_from_this<So
 		bool successfulAttackReported(const AttackOrder& r);
 
 	private:
+		friend class boost::serialization::access;
+		Soldier();
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		void globalMessage(const char* s);
 		void handleSleep(float time);
 		void handleEating(float time);
+		void updateLeaderUnitPositions();
+		void addKnownEnemy(const SoldierPtr& s, int count);
+		void addKnownEnemies(const Soldier& commandee, int sign);
 
 		boost::shared_ptr<World> mWorld;
 		SidePtr mSide;
@@ -146,7 +171,6 @@ class Soldier : public Common::Vehicle, public boost::enable_shared_from_this<So
 		std::vector<WeaponPtr> mBackupWeapons;
 		unsigned int mCurrentWeaponIndex;
 		boost::shared_ptr<SensorySystem> mSensorySystem;
-		std::vector<EventPtr> mEvents;
 		SoldierRank mRank;
 		std::list<SoldierPtr> mCommandees;
 		SoldierPtr mLeader;
@@ -162,6 +186,19 @@ class Soldier : public Common::Vehicle, public boost::enable_shared_from_this<So
 		Common::Vector3 mFormationOffset;
 		Common::Vector3 mDefendPosition;
 
+		// the soldiers sensed in the unit led by the soldier with the
+		// number of soldiers in the unit sensing each. The sensory
+		// systems and the changes in the commandees push their changes
+		// up the command tree, so they're always up to date. Not saved
+		// but rebuilt when loading.
+		std::map<SoldierPtr, int> mKnownEnemyCounts;
+		std::set<SoldierPtr> mKnownEnemies;
+		unsigned int mKnownEnemiesVersion = 0;
+
+		// the position of the unit, computed after each world update and
+		// each change in the commandees of the unit
+		Common::Vector3 mUnitPosition;
+
 		// leader status
 		bool mAttacking;
 		AttackOrder mAttackOrder;
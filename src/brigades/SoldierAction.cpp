@@ -2,6 +2,7 @@
 
 #include "SoldierAction.h"
 #include "SensorySystem.h"
+#include "AgentDirectory.h"
 
 namespace Brigades {
 
@@ -8,10 +8,11 @@
 #include "Soldier.h"
 #include "SoldierQuery.h"
 #include "SoldierController.h"
-#include "AgentDirectory.h"
 
 namespace Brigades {
 
+class AgentDirectory;
+
 enum class SAType {
 	StartDigging,
 	StopDigging,
@@ -47,6 +48,7 @@ class SoldierAction {
 
 
 	private:
+		friend class ReplayRecorder;
 		bool doCommunication(SoldierPtr s, boost::shared_ptr<SoldierController>& controller);
 		bool tryMount(SoldierPtr s, boost::shared_ptr<SoldierController>& controller);
 		bool tryUnmount(SoldierPtr s, boost::shared_ptr<SoldierController>& controller);
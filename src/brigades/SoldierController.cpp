@@ -201,7 +201,7 @@ bool SoldierController::checkLeaderStatus()
 					 * not seeing the new sergeant are left dangling. */
 					mSoldier->addCommandee(c);
 				}
-				deceased->getCommandees().clear();
+				deceased->clearCommandees();
 				if(newleader) {
 					newleader->removeCommandee(deceased);
 					newleader->addCommandee(mSoldier);
@@ -3,6 +3,7 @@
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "Soldier.h"
 #include "SoldierQuery.h"
@@ -35,6 +36,9 @@ struct SoldierCommunication {
 	CommunicationType comm;
 	OrderType order;
 	void* data;
+
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int version);
 };
 
 class SoldierController : public boost::enable_shared_from_this<SoldierController> {
@@ -48,6 +52,12 @@ class SoldierController : public boost::enable_shared_from_this<SoldierControlle
 
 
 	private:
+		friend class boost::serialization::access;
+		// the soldier is not saved; the controller for a loaded soldier
+		// is created before loading its state.
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		Common::Vector3 defaultMovement() const;
 		bool moveTo(const Common::Vector3& dir, float time, bool autorotate);
 		bool turnTo(const Common::Vector3& dir);
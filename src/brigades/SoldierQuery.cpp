@@ -102,21 +102,26 @@ std::vector<WeaponQuery> SoldierQuery::getWeapons() const
 
 Common::Vector3 SoldierQuery::getUnitPosition() const
 {
-	// TODO
-	assert(0);
-	return Common::Vector3();
+	soldier_query_check();
+	return mSoldier->getUnitPosition();
 }
 
 std::set<SoldierQuery> SoldierQuery::getKnownEnemySoldiers() const
 {
 	soldier_query_check();
 	std::set<SoldierQuery> ret;
-	auto sps = mSoldier->getKnownEnemySoldiers();
+	auto& sps = mSoldier->getKnownEnemySoldiers();
 	for(auto s : sps)
 		ret.insert(SoldierQuery(s));
 	return ret;
 }
 
+unsigned int SoldierQuery::getKnownEnemySoldiersVersion() const
+{
+	soldier_query_check();
+	return mSoldier->getKnownEnemySoldiersVersion();
+}
+
 SoldierRank SoldierQuery::getRank() const
 {
 	soldier_query_check();
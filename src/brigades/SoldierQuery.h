@@ -38,6 +38,8 @@ class SoldierQuery {
 		std::vector<WeaponQuery> getWeapons() const;
 		Common::Vector3 getUnitPosition() const;
 		std::set<SoldierQuery> getKnownEnemySoldiers() const;
+		// changes whenever the known enemy soldiers change
+		unsigned int getKnownEnemySoldiersVersion() const;
 		SoldierRank getRank() const;
 		std::vector<SoldierQuery> getCommandees() const;
 		bool hasLeader() const;
@@ -79,6 +81,10 @@ class SoldierQuery {
 		bool operator<(const SoldierQuery& f) const;
 
 	private:
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		boost::shared_ptr<Soldier> mSoldier;
 		friend SoldierQuery;
 		friend class SoldierAction;
@@ -0,0 +1,198 @@
+#ifndef BRIGADES_SPATIALGRID_H
+#define BRIGADES_SPATIALGRID_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+#include "common/Vector3.h"
+
+namespace Brigades {
+
+// Uniform grid over a world centered at the origin. Positions outside
+// the world are stored in the nearest border cell, so queries only
+// return candidates and the caller does the exact distance check. The
+// cells are made larger than asked for on large worlds to limit the
+// number of cells.
+template<typename T>
+class SpatialGrid {
+	public:
+		SpatialGrid(float width, float height, float cellsize);
+		void add(const T& t, const Common::Vector3& pos);
+		bool remove(const T& t, const Common::Vector3& pos);
+		void update(const T& t, const Common::Vector3& oldpos, const Common::Vector3& newpos);
+		bool replace(const T& oldt, const T& newt, const Common::Vector3& pos);
+		void clear();
+
+		// calls f(t) for every item in the cells overlapping the circle.
+		template<typename F>
+		void queryCircle(const Common::Vector3& pos, float radius, F f) const;
+
+		// calls f(t) for every item in the cells along the segment,
+		// widened by margin on both sides.
+		template<typename F>
+		void querySegment(const Common::Vector3& start, const Common::Vector3& end,
+				float margin, F f) const;
+
+	private:
+		int column(float x) const;
+		int row(float y) const;
+		std::vector<T>& getCell(const Common::Vector3& pos);
+
+		static const int MaxCells = 1 << 16;
+
+		float mWidth;
+		float mHeight;
+		float mCellSize;
+		int mColumns;
+		int mRows;
+		std::vector<std::vector<T>> mCells;
+};
+
+template<typename T>
+SpatialGrid<T>::SpatialGrid(float width, float height, float cellsize)
+	: mWidth(width),
+	mHeight(height),
+	mCellSize(std::max(cellsize, sqrtf(width * height / MaxCells))),
+	mColumns(std::max(1, int(ceil(width / mCellSize)))),
+	mRows(std::max(1, int(ceil(height / mCellSize)))),
+	mCells(mColumns * mRows)
+{
+}
+
+template<typename T>
+int SpatialGrid<T>::column(float x) const
+{
+	int c = int((x + mWidth * 0.5f) / mCellSize);
+	return std::min(mColumns - 1, std::max(0, c));
+}
+
+template<typename T>
+int SpatialGrid<T>::row(float y) const
+{
+	int r = int((y + mHeight * 0.5f) / mCellSize);
+	return std::min(mRows - 1, std::max(0, r));
+}
+
+template<typename T>
+std::vector<T>& SpatialGrid<T>::getCell(const Common::Vector3& pos)
+{
+	return mCells[row(pos.y) * mColumns + column(pos.x)];
+}
+
+template<typename T>
+void SpatialGrid<T>::add(const T& t, const Common::Vector3& pos)
+{
+	getCell(pos).push_back(t);
+}
+
+template<typename T>
+bool SpatialGrid<T>::remove(const T& t, const Common::Vector3& pos)
+{
+	auto& cell = getCell(pos);
+	auto it = std::find(cell.begin(), cell.end(), t);
+	if(it == cell.end())
+		return false;
+
+	*it = cell.back();
+	cell.pop_back();
+	return true;
+}
+
+template<typename T>
+void SpatialGrid<T>::update(const T& t, const Common::Vector3& oldpos, const Common::Vector3& newpos)
+{
+	auto& oldcell = getCell(oldpos);
+	auto& newcell = getCell(newpos);
+	if(&oldcell == &newcell)
+		return;
+
+	bool found = remove(t, oldpos);
+	assert(found);
+	if(found)
+		newcell.push_back(t);
+}
+
+template<typename T>
+bool SpatialGrid<T>::replace(const T& oldt, const T& newt, const Common::Vector3& pos)
+{
+	auto& cell = getCell(pos);
+	auto it = std::find(cell.begin(), cell.end(), oldt);
+	if(it == cell.end())
+		return false;
+
+	*it = newt;
+	return true;
+}
+
+template<typename T>
+void SpatialGrid<T>::clear()
+{
+	for(auto& c : mCells)
+		c.clear();
+}
+
+template<typename T>
+template<typename F>
+void SpatialGrid<T>::queryCircle(const Common::Vector3& pos, float radius, F f) const
+{
+	int minc = column(pos.x - radius);
+	int maxc = column(pos.x + radius);
+	int minr = row(pos.y - radius);
+	int maxr = row(pos.y + radius);
+
+	for(int j = minr; j <= maxr; j++) {
+		for(int i = minc; i <= maxc; i++) {
+			for(const T& t : mCells[j * mColumns + i]) {
+				f(t);
+			}
+		}
+	}
+}
+
+template<typename T>
+template<typename F>
+void SpatialGrid<T>::querySegment(const Common::Vector3& start, const Common::Vector3& end,
+		float margin, F f) const
+{
+	float miny = std::min(start.y, end.y) - margin;
+	float maxy = std::max(start.y, end.y) + margin;
+	int minr = row(miny);
+	int maxr = row(maxy);
+	float dy = end.y - start.y;
+
+	for(int j = minr; j <= maxr; j++) {
+		// y range of the segment within this row; the border rows
+		// also contain everything beyond the world edge.
+		float rowmin = j == 0 ? miny : j * mCellSize - mHeight * 0.5f;
+		float rowmax = j == mRows - 1 ? maxy : (j + 1) * mCellSize - mHeight * 0.5f;
+
+		float t0 = 0.0f;
+		float t1 = 1.0f;
+		if(fabs(dy) > 0.0001f) {
+			t0 = (rowmin - margin - start.y) / dy;
+			t1 = (rowmax + margin - start.y) / dy;
+			if(t0 > t1)
+				std::swap(t0, t1);
+			t0 = std::max(0.0f, t0);
+			t1 = std::min(1.0f, t1);
+		}
+
+		float x0 = start.x + (end.x - start.x) * t0;
+		float x1 = start.x + (end.x - start.x) * t1;
+		int minc = column(std::min(x0, x1) - margin);
+		int maxc = column(std::max(x0, x1) + margin);
+
+		for(int i = minc; i <= maxc; i++) {
+			for(const T& t : mCells[j * mColumns + i]) {
+				f(t);
+			}
+		}
+	}
+}
+
+}
+
+#endif
+
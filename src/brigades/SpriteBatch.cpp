@@ -0,0 +1,229 @@
+// for the vertex buffer functions
+#define GL_GLEXT_PROTOTYPES
+
+#include <cstddef>
+#include <algorithm>
+
+#include "SpriteBatch.h"
+
+using namespace Common;
+
+namespace Brigades {
+
+SpriteBatch::SpriteBatch()
+	: mShelfX(0),
+	mShelfY(0),
+	mShelfHeight(0),
+	mQuads(0),
+	mDrawCalls(0)
+{
+	glGenTextures(1, &mAtlas);
+	glBindTexture(GL_TEXTURE_2D, mAtlas);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	std::vector<uint8_t> empty(AtlasSize * AtlasSize * 4, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, AtlasSize, AtlasSize, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, &empty[0]);
+
+	// a white block in the corner for the untextured quads
+	static const int whiteSize = 4;
+	std::vector<uint8_t> white(whiteSize * whiteSize * 4, 255);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, whiteSize, whiteSize,
+			GL_RGBA, GL_UNSIGNED_BYTE, &white[0]);
+	mWhite = Rectangle(whiteSize * 0.5f / AtlasSize, whiteSize * 0.5f / AtlasSize, 0.0f, 0.0f);
+	mShelfX = whiteSize;
+	mShelfHeight = whiteSize;
+
+	glGenBuffers(1, &mBuffer);
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	glDeleteBuffers(1, &mBuffer);
+	glDeleteTextures(1, &mAtlas);
+}
+
+bool SpriteBatch::addToAtlas(const Texture& t)
+{
+	GLuint name = t.getTexture();
+	if(mAtlasRegions.find(name) != mAtlasRegions.end())
+		return true;
+
+	GLint w, h;
+	glBindTexture(GL_TEXTURE_2D, name);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+	if(w <= 0 || h <= 0 || w > MaxAtlasTextureSize || h > MaxAtlasTextureSize)
+		return false;
+
+	// the edges are repeated around the texture so that filtering at
+	// the edges doesn't pick up its neighbours.
+	int pw = w + 2;
+	int ph = h + 2;
+	if(mShelfX + pw > AtlasSize) {
+		mShelfX = 0;
+		mShelfY += mShelfHeight;
+		mShelfHeight = 0;
+	}
+	if(mShelfY + ph > AtlasSize)
+		return false;
+
+	std::vector<uint8_t> pixels(w * h * 4);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	std::vector<uint8_t> padded(pw * ph * 4);
+	for(int y = 0; y < ph; y++) {
+		int sy = std::min(std::max(y - 1, 0), h - 1);
+		for(int x = 0; x < pw; x++) {
+			int sx = std::min(std::max(x - 1, 0), w - 1);
+			std::copy(&pixels[(sy * w + sx) * 4], &pixels[(sy * w + sx) * 4] + 4,
+					&padded[(y * pw + x) * 4]);
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, mAtlas);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, mShelfX, mShelfY, pw, ph,
+			GL_RGBA, GL_UNSIGNED_BYTE, &padded[0]);
+	mAtlasRegions[name] = Rectangle((mShelfX + 1) / float(AtlasSize), (mShelfY + 1) / float(AtlasSize),
+			w / float(AtlasSize), h / float(AtlasSize));
+
+	mShelfX += pw;
+	mShelfHeight = std::max(mShelfHeight, ph);
+	return true;
+}
+
+void SpriteBatch::addSprite(const Texture& t, const Rectangle& vertcoords,
+		const Rectangle& texcoords, const Color& c, float alpha)
+{
+	const Vector3 corners[4] = {
+		Vector3(vertcoords.x, vertcoords.y, 0.0f),
+		Vector3(vertcoords.x + vertcoords.w, vertcoords.y, 0.0f),
+		Vector3(vertcoords.x + vertcoords.w, vertcoords.y + vertcoords.h, 0.0f),
+		Vector3(vertcoords.x, vertcoords.y + vertcoords.h, 0.0f),
+	};
+	const float tc[8] = {
+		texcoords.x, texcoords.y,
+		texcoords.x + texcoords.w, texcoords.y,
+		texcoords.x + texcoords.w, texcoords.y + texcoords.h,
+		texcoords.x, texcoords.y + texcoords.h,
+	};
+	addQuad(t, corners, tc, c, alpha);
+}
+
+void SpriteBatch::addPoint(const Vector3& pos, float size, const Color& c)
+{
+	float h = size * 0.5f;
+	const Vector3 corners[4] = {
+		Vector3(pos.x - h, pos.y - h, 0.0f),
+		Vector3(pos.x + h, pos.y - h, 0.0f),
+		Vector3(pos.x + h, pos.y + h, 0.0f),
+		Vector3(pos.x - h, pos.y + h, 0.0f),
+	};
+	const float tc[8] = {
+		mWhite.x, mWhite.y, mWhite.x, mWhite.y,
+		mWhite.x, mWhite.y, mWhite.x, mWhite.y,
+	};
+	addVertices(mAtlas, corners, tc, c, 1.0f);
+}
+
+void SpriteBatch::addQuad(const Texture& t, const Vector3 corners[4],
+		const float texcoords[8], const Color& c, float alpha)
+{
+	auto it = mAtlasRegions.find(t.getTexture());
+	if(it == mAtlasRegions.end()) {
+		addVertices(t.getTexture(), corners, texcoords, c, alpha);
+		return;
+	}
+
+	const Rectangle& r = it->second;
+	float tc[8];
+	for(int i = 0; i < 4; i++) {
+		tc[i * 2]     = r.x + texcoords[i * 2] * r.w;
+		tc[i * 2 + 1] = r.y + texcoords[i * 2 + 1] * r.h;
+	}
+	addVertices(mAtlas, corners, tc, c, alpha);
+}
+
+void SpriteBatch::addQuad(GLuint texture, const Vector3 corners[4],
+		const float texcoords[8], const Color& c, float alpha)
+{
+	addVertices(texture, corners, texcoords, c, alpha);
+}
+
+void SpriteBatch::addVertices(GLuint texture, const Vector3 corners[4],
+		const float texcoords[8], const Color& c, float alpha)
+{
+	if(mBatches.empty() || mBatches.back().texture != texture) {
+		Batch b = { texture, (unsigned int)mVertices.size(), 0 };
+		mBatches.push_back(b);
+	}
+
+	uint8_t a = std::min(std::max(alpha, 0.0f), 1.0f) * 255.0f;
+	for(int i = 0; i < 4; i++) {
+		Vertex v;
+		v.x = corners[i].x;
+		v.y = corners[i].y;
+		v.u = texcoords[i * 2];
+		v.v = texcoords[i * 2 + 1];
+		v.color[0] = c.r;
+		v.color[1] = c.g;
+		v.color[2] = c.b;
+		v.color[3] = a;
+		mVertices.push_back(v);
+	}
+	mBatches.back().count += 4;
+}
+
+void SpriteBatch::flush()
+{
+	mQuads += mVertices.size() / 4;
+	if(mVertices.empty())
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+	// a new buffer every frame so the driver doesn't have to wait for
+	// the previous frame to finish drawing from it
+	glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), &mVertices[0], GL_STREAM_DRAW);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, x));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, u));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, color));
+
+	glEnable(GL_TEXTURE_2D);
+	for(auto& b : mBatches) {
+		glBindTexture(GL_TEXTURE_2D, b.texture);
+		glDrawArrays(GL_QUADS, b.first, b.count);
+		mDrawCalls++;
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mVertices.clear();
+	mBatches.clear();
+}
+
+unsigned int SpriteBatch::getNumQuads() const
+{
+	return mQuads;
+}
+
+unsigned int SpriteBatch::getNumDrawCalls() const
+{
+	return mDrawCalls;
+}
+
+void SpriteBatch::resetStats()
+{
+	mQuads = 0;
+	mDrawCalls = 0;
+}
+
+}
+
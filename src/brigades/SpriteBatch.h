@@ -0,0 +1,95 @@
+#ifndef BRIGADES_SPRITEBATCH_H
+#define BRIGADES_SPRITEBATCH_H
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+#include "common/Color.h"
+#include "common/Rectangle.h"
+#include "common/Texture.h"
+#include "common/Vector3.h"
+
+namespace Brigades {
+
+// Collects textured quads for a frame and draws them from one vertex
+// buffer. The small textures that are used a lot are copied into an
+// atlas, so consecutive quads with any of them are drawn with a single
+// draw call; the other textures get a draw call of their own. The quads
+// are drawn in the order they were added. Needs an OpenGL context.
+class SpriteBatch {
+	public:
+		SpriteBatch();
+		~SpriteBatch();
+
+		// copies the texture into the atlas. Returns false if it's too
+		// large or the atlas is full, in which case it's drawn on its
+		// own. Textures with repeating texture coordinates mustn't be
+		// added.
+		bool addToAtlas(const Common::Texture& t);
+
+		// as SDL_utils::drawSpriteWithColor with zero depth
+		void addSprite(const Common::Texture& t, const Common::Rectangle& vertcoords,
+				const Common::Rectangle& texcoords, const Common::Color& c, float alpha = 1.0f);
+		// a square of the size in pixels centered at the position, as
+		// SDL_utils::drawPoint
+		void addPoint(const Common::Vector3& pos, float size, const Common::Color& c);
+		// the corners and their texture coordinates in drawing order
+		void addQuad(const Common::Texture& t, const Common::Vector3 corners[4],
+				const float texcoords[8], const Common::Color& c, float alpha = 1.0f);
+		// as above with an OpenGL texture of the caller, e.g. another
+		// atlas
+		void addQuad(GLuint texture, const Common::Vector3 corners[4],
+				const float texcoords[8], const Common::Color& c, float alpha = 1.0f);
+
+		// draws and clears the quads. The current color is undefined
+		// afterwards.
+		void flush();
+		// in the flushes since resetStats()
+		unsigned int getNumQuads() const;
+		unsigned int getNumDrawCalls() const;
+		void resetStats();
+
+	private:
+		struct Vertex {
+			float x;
+			float y;
+			float u;
+			float v;
+			uint8_t color[4];
+		};
+
+		struct Batch {
+			GLuint texture;
+			unsigned int first;
+			unsigned int count;
+		};
+
+		void addVertices(GLuint texture, const Common::Vector3 corners[4],
+				const float texcoords[8], const Common::Color& c, float alpha);
+
+		static const int AtlasSize = 1024;
+		static const int MaxAtlasTextureSize = 256;
+
+		GLuint mAtlas;
+		GLuint mBuffer;
+		// the texture coordinates of the textures in the atlas by their
+		// OpenGL names
+		std::map<GLuint, Common::Rectangle> mAtlasRegions;
+		Common::Rectangle mWhite;
+		// shelf packing: the textures are placed in rows from left to right
+		int mShelfX;
+		int mShelfY;
+		int mShelfHeight;
+
+		std::vector<Vertex> mVertices;
+		std::vector<Batch> mBatches;
+		unsigned int mQuads;
+		unsigned int mDrawCalls;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,283 @@
+// for the vertex buffer functions
+#define GL_GLEXT_PROTOTYPES
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+#include "common/Math.h"
+
+#include "StaticGeometry.h"
+
+using namespace Common;
+
+namespace Brigades {
+
+// as in Terrain
+static const float maxTreeRadius = 8.0f;
+
+// the corners and texture coordinates of SDL_utils::drawSprite with the
+// texture flipped, as the sprites are drawn
+void StaticGeometry::addSprite(std::vector<Vertex>& vertices,
+		float x, float y, float w, float h)
+{
+	const Vertex quad[4] = {
+		{ x,     y,     1.0f, 1.0f },
+		{ x + w, y,     0.0f, 1.0f },
+		{ x + w, y + h, 0.0f, 0.0f },
+		{ x,     y + h, 1.0f, 0.0f },
+	};
+	vertices.insert(vertices.end(), quad, quad + 4);
+}
+
+StaticGeometry::StaticGeometry(WorldPtr world, const Texture* treeShadow,
+		const Texture* road, float treeScale)
+	: mWorld(world),
+	mTreeScale(treeScale),
+	mRevision(world->getTerrainRevision()),
+	mFrame(0),
+	mScale(1.0f),
+	mScreenWidth(0.0f),
+	mScreenHeight(0.0f),
+	mDrawCalls(0)
+{
+	mTextures[int(StaticLayer::TreeShadows)] = treeShadow;
+	mTextures[int(StaticLayer::Roads)] = road;
+
+	// a road belongs to the tile its middle point is in, so the
+	// longest road determines how far out the tiles need to be looked
+	// at. The roads don't change after the terrain was created.
+	float maxRoadLength = 0.0f;
+	for(auto r : mWorld->getRoadsAt(Vector3(), std::max(mWorld->getWidth(), mWorld->getHeight()))) {
+		maxRoadLength = std::max(maxRoadLength, r->getStart().distance(r->getEnd()));
+	}
+	mMargin = std::max(maxRoadLength * 0.5f + mWorld->getRoadWidth() * 2.0f,
+			maxTreeRadius * mTreeScale);
+}
+
+StaticGeometry::~StaticGeometry()
+{
+	clear();
+}
+
+void StaticGeometry::clear()
+{
+	for(auto& t : mTiles) {
+		if(t.second.buffer)
+			glDeleteBuffers(1, &t.second.buffer);
+	}
+	mTiles.clear();
+	mVisible.clear();
+}
+
+void StaticGeometry::buildTile(const TileKey& key, Tile& tile) const
+{
+	tile.x = key.first * TileSize;
+	tile.y = key.second * TileSize;
+	tile.buffer = 0;
+	tile.minX = tile.minY = FLT_MAX;
+	tile.maxX = tile.maxY = -FLT_MAX;
+	tile.lastSeen = mFrame;
+	tile.trees.clear();
+
+	std::vector<Vertex> layers[int(StaticLayer::NumLayers)];
+	const Vector3 center(tile.x + TileSize * 0.5f, tile.y + TileSize * 0.5f, 0.0f);
+	auto inTile = [&] (const Vector3& v) {
+		return v.x >= tile.x && v.x < tile.x + TileSize &&
+			v.y >= tile.y && v.y < tile.y + TileSize;
+	};
+
+	// as the sprites in Driver::drawEntities. The trees are part of the
+	// bounding box so that the tile is in view when they are.
+	for(auto t : mWorld->getTreesAt(center, TileSize * 0.5f)) {
+		const Vector3& v = t->getPosition();
+		if(!inTile(v))
+			continue;
+
+		float s = t->getRadius() * mTreeScale;
+		float x = v.x - tile.x;
+		float y = v.y - tile.y;
+		addSprite(layers[int(StaticLayer::TreeShadows)],
+				x - 0.5f * s + v.z * 0.15f * s, y - 0.8f * s - v.z * 0.20f * s, s, s);
+		tile.trees.push_back(t);
+		tile.minX = std::min(tile.minX, v.x - 0.5f * s);
+		tile.minY = std::min(tile.minY, v.y - 0.5f * s + v.z * 0.3f * s);
+		tile.maxX = std::max(tile.maxX, v.x + 0.5f * s);
+		tile.maxY = std::max(tile.maxY, v.y + 0.5f * s + v.z * 0.3f * s);
+	}
+
+	// the road segments are extended to avoid holes inbetween
+	const float roadWidth = mWorld->getRoadWidth();
+	for(auto r : mWorld->getRoadsAt(center, TileSize * 0.5f + mMargin)) {
+		auto p1 = r->getStart();
+		auto p2 = r->getEnd();
+		if(!inTile((p1 + p2) * 0.5f))
+			continue;
+
+		auto dir = p1 - p2;
+		const auto roadlen = dir.length();
+		assert(roadlen);
+		dir = dir.normalized() * roadWidth;
+		p1 = p1 + dir * 0.5f;
+		p2 = p2 - dir * 0.5f;
+		const Vector3 corners[4] = {
+			p1 + Math::rotate2D(dir, -90.0f),
+			p1 + Math::rotate2D(dir, 90.0f),
+			p2 + Math::rotate2D(dir, 90.0f),
+			p2 + Math::rotate2D(dir, -90.0f),
+		};
+		// the road texture repeats along the road
+		const float texcoords[8] = {
+			1.0f, 0.0f,
+			0.0f, 0.0f,
+			0.0f, roadlen * 0.1f,
+			1.0f, roadlen * 0.1f,
+		};
+		for(int i = 0; i < 4; i++) {
+			Vertex vert = { corners[i].x + corners[i].z * 0.15f - tile.x,
+				corners[i].y - corners[i].z * 0.20f - tile.y,
+				texcoords[i * 2], texcoords[i * 2 + 1] };
+			layers[int(StaticLayer::Roads)].push_back(vert);
+		}
+	}
+
+	std::vector<Vertex> vertices;
+	for(int i = 0; i < int(StaticLayer::NumLayers); i++) {
+		tile.first[i] = vertices.size();
+		tile.count[i] = layers[i].size();
+		vertices.insert(vertices.end(), layers[i].begin(), layers[i].end());
+	}
+
+	if(vertices.empty())
+		return;
+
+	for(auto& v : vertices) {
+		tile.minX = std::min(tile.minX, tile.x + v.x);
+		tile.minY = std::min(tile.minY, tile.y + v.y);
+		tile.maxX = std::max(tile.maxX, tile.x + v.x);
+		tile.maxY = std::max(tile.maxY, tile.y + v.y);
+	}
+
+	glGenBuffers(1, &tile.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, tile.buffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void StaticGeometry::setView(const Vector3& camera, float scale,
+		float screenWidth, float screenHeight)
+{
+	if(mRevision != mWorld->getTerrainRevision()) {
+		mRevision = mWorld->getTerrainRevision();
+		clear();
+	}
+
+	mFrame++;
+	mCamera = camera;
+	mScale = scale;
+	mScreenWidth = screenWidth;
+	mScreenHeight = screenHeight;
+	mVisible.clear();
+	mDrawCalls = 0;
+
+	for(auto it = mTiles.begin(); it != mTiles.end(); ) {
+		if(mFrame - it->second.lastSeen > EvictFrames) {
+			if(it->second.buffer)
+				glDeleteBuffers(1, &it->second.buffer);
+			it = mTiles.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	float minX = camera.x - screenWidth * 0.5f / scale;
+	float maxX = camera.x + screenWidth * 0.5f / scale;
+	float minY = camera.y - screenHeight * 0.5f / scale;
+	float maxY = camera.y + screenHeight * 0.5f / scale;
+
+	// the tiles whose quads may reach into the view, within the terrain
+	float halfWidth = mWorld->getWidth() * 0.5f;
+	float halfHeight = mWorld->getHeight() * 0.5f;
+	int j0 = floor((std::max(minX - mMargin, -halfWidth)) / TileSize);
+	int j1 = floor((std::min(maxX + mMargin, halfWidth - 1.0f)) / TileSize);
+	int k0 = floor((std::max(minY - mMargin, -halfHeight)) / TileSize);
+	int k1 = floor((std::min(maxY + mMargin, halfHeight - 1.0f)) / TileSize);
+
+	for(int k = k0; k <= k1; k++) {
+		for(int j = j0; j <= j1; j++) {
+			TileKey key(j, k);
+			auto it = mTiles.find(key);
+			if(it == mTiles.end()) {
+				it = mTiles.insert(std::make_pair(key, Tile())).first;
+				buildTile(key, it->second);
+			}
+
+			Tile& t = it->second;
+			t.lastSeen = mFrame;
+			if(t.buffer && t.maxX >= minX && t.minX <= maxX &&
+					t.maxY >= minY && t.minY <= maxY)
+				mVisible.push_back(&t);
+		}
+	}
+}
+
+void StaticGeometry::draw(StaticLayer l, const Color& c)
+{
+	if(mVisible.empty())
+		return;
+
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, mTextures[int(l)]->getTexture());
+	glColor4ub(c.r, c.g, c.b, 255);
+
+	// world to screen coordinates as in Driver
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glTranslatef(mScreenWidth * 0.5f, mScreenHeight * 0.5f, 0.0f);
+	glScalef(mScale, mScale, 1.0f);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	for(auto t : mVisible) {
+		if(!t->count[int(l)])
+			continue;
+
+		glPushMatrix();
+		glTranslatef(t->x - mCamera.x, t->y - mCamera.y, 0.0f);
+		glBindBuffer(GL_ARRAY_BUFFER, t->buffer);
+		glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, x));
+		glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, u));
+		glDrawArrays(GL_QUADS, t->first[int(l)], t->count[int(l)]);
+		glPopMatrix();
+		mDrawCalls++;
+	}
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glPopMatrix();
+}
+
+std::vector<const Tree*> StaticGeometry::getVisibleTrees() const
+{
+	std::vector<const Tree*> trees;
+	for(auto t : mVisible) {
+		trees.insert(trees.end(), t->trees.begin(), t->trees.end());
+	}
+	return trees;
+}
+
+unsigned int StaticGeometry::getNumTiles() const
+{
+	return mTiles.size();
+}
+
+unsigned int StaticGeometry::getNumDrawCalls() const
+{
+	return mDrawCalls;
+}
+
+}
+
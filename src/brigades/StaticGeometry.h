@@ -0,0 +1,104 @@
+#ifndef BRIGADES_STATICGEOMETRY_H
+#define BRIGADES_STATICGEOMETRY_H
+
+#include <map>
+#include <vector>
+
+#include "common/Color.h"
+#include "common/Texture.h"
+#include "common/Vector3.h"
+
+#include "World.h"
+
+namespace Brigades {
+
+enum class StaticLayer {
+	TreeShadows,
+	Roads,
+	NumLayers
+};
+
+// Keeps the quads of the tree shadows and the roads in vertex buffers,
+// one per square tile of the terrain. A tile is built when it first comes
+// into view and dropped when it hasn't been in view for a while, and all
+// tiles are rebuilt when the trees of streamed terrain change. The
+// vertices are in world coordinates relative to the tile, so moving the
+// camera only changes the transformation. The trees themselves are
+// depth-sorted with the other sprites, so the tiles only keep the list of
+// their trees for them. Needs an OpenGL context.
+class StaticGeometry {
+	public:
+		// the tree shadows are drawn as in Driver::drawEntities,
+		// treeScale times the radius of the tree in size.
+		StaticGeometry(WorldPtr world, const Common::Texture* treeShadow,
+				const Common::Texture* road, float treeScale);
+		~StaticGeometry();
+
+		// builds the tiles that are missing in the view, picks the tiles
+		// to draw and drops those that have been out of view for long.
+		// Called once per frame before drawing.
+		void setView(const Common::Vector3& camera, float scale,
+				float screenWidth, float screenHeight);
+		void draw(StaticLayer l, const Common::Color& c);
+		// the trees of the tiles in view since setView()
+		std::vector<const Tree*> getVisibleTrees() const;
+
+		// the number of tiles built and the draw calls since setView()
+		unsigned int getNumTiles() const;
+		unsigned int getNumDrawCalls() const;
+
+	private:
+		struct Vertex {
+			float x;
+			float y;
+			float u;
+			float v;
+		};
+
+		typedef std::pair<int, int> TileKey;
+
+		struct Tile {
+			GLuint buffer;
+			// the corner of the tile the vertices are relative to
+			float x;
+			float y;
+			// the bounding box of the quads
+			float minX;
+			float minY;
+			float maxX;
+			float maxY;
+			// the first vertex and the number of vertices of each layer
+			unsigned int first[int(StaticLayer::NumLayers)];
+			unsigned int count[int(StaticLayer::NumLayers)];
+			unsigned int lastSeen;
+			std::vector<const Tree*> trees;
+		};
+
+		static void addSprite(std::vector<Vertex>& vertices, float x, float y, float w, float h);
+		void buildTile(const TileKey& key, Tile& tile) const;
+		void clear();
+
+		static const int TileSize = 256;
+		static const unsigned int EvictFrames = 300;
+
+		WorldPtr mWorld;
+		const Common::Texture* mTextures[int(StaticLayer::NumLayers)];
+		float mTreeScale;
+		// how far the quads of a tile may reach out of it
+		float mMargin;
+		unsigned int mRevision;
+		unsigned int mFrame;
+
+		std::map<TileKey, Tile> mTiles;
+		Common::Vector3 mCamera;
+		float mScale;
+		float mScreenWidth;
+		float mScreenHeight;
+		std::vector<const Tile*> mVisible;
+		unsigned int mDrawCalls;
+};
+
+}
+
+#endif
+
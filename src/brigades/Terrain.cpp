@@ -1,8 +1,24 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
 #include "Terrain.h"
+#include "IndexedPriorityQueue.h"
+#include "ThreadPool.h"
 
 #include "common/Vector2.h"
-#include "common/Random.h"
-#include "common/AStar.h"
+#include "common/Clock.h"
 
 using namespace Common;
 
@@ -15,324 +31,857 @@ Tree::Tree(const Vector3& pos, float radius)
 }
 
 
-Terrain::Terrain(int w, int h)
+std::string Terrain::CacheDirectory;
+
+// The cache file is the header followed by the trees as x, y and radius
+// and the roads as start and end x and y, all as native floats. Bump the
+// version when the generated terrain changes.
+struct TerrainCacheHeader {
+	char magic[8];
+	uint32_t version;
+	int32_t seed;
+	int32_t width;
+	int32_t height;
+	uint32_t numTrees;
+	uint32_t numRoads;
+};
+
+static const char terrainCacheMagic[8] = { 'B', 'R', 'I', 'G', 'T', 'E', 'R', 'R' };
+static const uint32_t terrainCacheVersion = 3;
+
+// the size of the squares the trees are placed in
+static const int squareSide = 64;
+static const float maxTreeRadius = 8.0f;
+
+Terrain::Terrain(int w, int h, int seed, TerrainMode mode)
 	: mWidth(w),
 	mHeight(h),
 	mTrees(AABB(Vector2(0, 0), Vector2(w * 0.5f, h * 0.5f))),
 	mRoads(Common::LineQuadTree<Road*>(AABB(Vector2(0, 0), Vector2(w * 0.5f, h * 0.5f)))),
-	mRoadWidth(5.0f)
+	mRoadWidth(5.0f),
+	mSeed(seed),
+	mRandom(seed),
+	mStreamed(mode == TerrainMode::Streamed),
+	mOcclusionMap(w, h, 1.0f)
 {
+	if(mode == TerrainMode::Generated) {
+		std::string filename = getCacheFilename();
+		if(filename.empty() || !loadCache(filename))
+			generateTerrain();
+		buildOcclusionMap();
+	} else if(mode == TerrainMode::Streamed) {
+		std::unordered_set<Tree*> removedTrees;
+		addRoads(removedTrees);
+	}
+}
+
+void Terrain::generateTerrain()
+{
+	double start = Clock::getTime();
+	std::unordered_set<Tree*> removedTrees;
 	addTrees();
-	addRoads();
+	addRoads(removedTrees);
+
+	// the trees are inserted again in the order they're written to the
+	// cache so that the index is the same whether the terrain was
+	// generated or loaded. The trees on the roads are left out.
+	float radius = std::max(mWidth, mHeight);
+	auto trees = getTreesAt(Vector3(0.0f, 0.0f, 0.0f), radius);
+	mTrees.clear();
+	trees.erase(std::remove_if(trees.begin(), trees.end(), [&] (Tree* t) {
+				return removedTrees.count(t) > 0; }), trees.end());
+	for(auto t : trees) {
+		bool ret = mTrees.insert(t, Vector2(t->getPosition().x, t->getPosition().y));
+		assert(ret);
+	}
+	for(auto t : removedTrees)
+		delete t;
+	printf("Generated the terrain in %.1f ms.\n", (Clock::getTime() - start) * 1000.0);
+
+	std::string filename = getCacheFilename();
+	if(!filename.empty())
+		saveCache(filename, trees, getRoadsAt(Vector3(0.0f, 0.0f, 0.0f), radius));
+}
+
+// 24 bits for a float in [0, 1)
+static float uniform(std::mt19937& gen)
+{
+	return (gen() >> 8) * (1.0f / 16777216.0f);
+}
+
+// a seed for the generator of one square, mixed so that the streams of
+// nearby squares and seeds aren't related.
+static uint32_t squareSeed(int seed, int j, int k)
+{
+	uint64_t h = (uint32_t)seed;
+	h = h * 0x9e3779b97f4a7c15ull + (uint32_t)j;
+	h = h * 0x9e3779b97f4a7c15ull + (uint32_t)k;
+	h ^= h >> 32;
+	h *= 0xd6e8feb86659fd93ull;
+	h ^= h >> 32;
+	return h;
+}
+
+float Terrain::random()
+{
+	return uniform(mRandom);
+}
+
+void Terrain::setCacheDirectory(const std::string& dir)
+{
+	CacheDirectory = dir;
+}
+
+const std::string& Terrain::getCacheDirectory()
+{
+	return CacheDirectory;
+}
+
+std::string Terrain::getDefaultCacheDirectory()
+{
+	std::string dir;
+	const char* xdg = getenv("XDG_CACHE_HOME");
+	const char* home = getenv("HOME");
+	if(xdg && *xdg) {
+		dir = xdg;
+	} else if(home && *home) {
+		dir = std::string(home) + "/.cache";
+		mkdir(dir.c_str(), 0755);
+	} else {
+		return std::string();
+	}
+
+	dir += "/brigades";
+	if(mkdir(dir.c_str(), 0755) && errno != EEXIST)
+		return std::string();
+	return dir;
+}
+
+std::string Terrain::getCacheFilename() const
+{
+	if(CacheDirectory.empty())
+		return std::string();
+
+	std::stringstream ss;
+	ss << CacheDirectory << "/terrain-" << mSeed << "-" << int(mWidth) << "x" << int(mHeight) << ".bin";
+	return ss.str();
+}
+
+// the file is mapped and the trees and roads are added straight from it.
+bool Terrain::loadCache(const std::string& filename)
+{
+	double start = Clock::getTime();
+	boost::iostreams::mapped_file_source file;
+	try {
+		file.open(filename);
+	} catch(std::exception&) {
+		return false;
+	}
+
+	TerrainCacheHeader header;
+	if(file.size() < sizeof(header))
+		return false;
+
+	memcpy(&header, file.data(), sizeof(header));
+	if(memcmp(header.magic, terrainCacheMagic, sizeof(header.magic)) ||
+			header.version != terrainCacheVersion ||
+			header.seed != mSeed ||
+			header.width != int(mWidth) || header.height != int(mHeight) ||
+			file.size() != sizeof(header) +
+			(header.numTrees * 3ul + header.numRoads * 4ul) * sizeof(float)) {
+		printf("Ignoring invalid terrain cache file %s.\n", filename.c_str());
+		return false;
+	}
+
+	const float* data = reinterpret_cast<const float*>(file.data() + sizeof(header));
+	for(unsigned int i = 0; i < header.numTrees; i++, data += 3)
+		addTree(Vector3(data[0], data[1], 0.0f), data[2]);
+	for(unsigned int i = 0; i < header.numRoads; i++, data += 4)
+		addRoad(Vector3(data[0], data[1], 0.0f), Vector3(data[2], data[3], 0.0f));
+
+	printf("Loaded %u trees and %u road segments from %s in %.1f ms.\n",
+			header.numTrees, header.numRoads, filename.c_str(),
+			(Clock::getTime() - start) * 1000.0);
+	return true;
+}
+
+// written to a temporary file first so that a concurrently started game
+// never maps a partial file.
+void Terrain::saveCache(const std::string& filename, const std::vector<Tree*>& trees,
+		const std::vector<Road*>& roads) const
+{
+	TerrainCacheHeader header;
+	memcpy(header.magic, terrainCacheMagic, sizeof(header.magic));
+	header.version = terrainCacheVersion;
+	header.seed = mSeed;
+	header.width = mWidth;
+	header.height = mHeight;
+	header.numTrees = trees.size();
+	header.numRoads = roads.size();
+
+	std::vector<float> data;
+	data.reserve(trees.size() * 3 + roads.size() * 4);
+	for(auto t : trees) {
+		data.insert(data.end(), { t->getPosition().x, t->getPosition().y, t->getRadius() });
+	}
+	for(auto r : roads) {
+		data.insert(data.end(), { r->getStart().x, r->getStart().y,
+				r->getEnd().x, r->getEnd().y });
+	}
+
+	std::string tmpname = filename + ".tmp";
+	std::ofstream os(tmpname, std::ios::binary);
+	os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	os.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
+	os.close();
+	if(!os || rename(tmpname.c_str(), filename.c_str())) {
+		printf("Warning: could not write the terrain cache file %s.\n", filename.c_str());
+		remove(tmpname.c_str());
+	}
+}
+
+void Terrain::buildOcclusionMap()
+{
+	for(auto t : getTreesAt(Vector3(0.0f, 0.0f, 0.0f), std::max(mWidth, mHeight))) {
+		mOcclusionMap.addCircle(t->getPosition(), t->getRadius());
+	}
+}
+
+bool Terrain::lineBlocked(const Vector3& from, const Vector3& to) const
+{
+	return mOcclusionMap.lineBlocked(from, to);
+}
+
+// the squares in the corners are left empty for the home bases.
+bool Terrain::isHomeBaseSquare(int j, int k) const
+{
+	int numXSquares = mWidth / squareSide;
+	int numYSquares = mHeight / squareSide;
+	return (k == -numYSquares / 2 && j == -numXSquares / 2) ||
+		(k == numYSquares / 2 - 1 && j == numXSquares / 2 - 1);
+}
+
+// The squares are handled in four passes by the parity of their
+// coordinates, so that no two squares of a pass are next to each other.
+static int squarePass(int j, int k)
+{
+	return (j & 1) * 2 + (k & 1);
+}
+
+// Places the trees of a square with its own random generator. A tree
+// can only be too close to the trees of its own square or of the squares
+// next to it, and it is checked against those of the neighbours that
+// come in an earlier pass. The neighbours of the later passes are checked
+// against this square in turn.
+void Terrain::placeTrees(int j, int k, const SquareTrees* neighbours[8], SquareTrees& trees) const
+{
+	std::mt19937 gen(squareSeed(mSeed, j, k));
+
+	int treefactor = 10 + uniform(gen) * 10;
+	for(int i = 0; i < treefactor; i++) {
+		float x = uniform(gen);
+		float y = uniform(gen);
+		float r = uniform(gen);
+
+		x *= squareSide;
+		y *= squareSide;
+		x += j * squareSide;
+		y += k * squareSide;
+		r = Common::clamp(2.0f, r * maxTreeRadius, maxTreeRadius);
+
+		auto tooClose = [&] (const SquareTrees& others) {
+			for(const auto& t : others) {
+				float maxdist = r + t.z;
+				if(Vector3(x, y, 0.0f).distance2(Vector3(t.x, t.y, 0.0f)) <
+						maxdist * maxdist) {
+					return true;
+				}
+			}
+			return false;
+		};
+
+		bool tooclose = tooClose(trees);
+		for(int n = 0; !tooclose && n < 8; n++) {
+			if(neighbours[n])
+				tooclose = tooClose(*neighbours[n]);
+		}
+		if(tooclose) {
+			continue;
+		}
+
+		trees.push_back(Vector3(x, y, r));
+	}
 }
 
+// The squares of a pass are placed in parallel, and the result doesn't
+// depend on the number of threads.
 void Terrain::addTrees()
 {
-	static const int squareSide = 64;
 	int numXSquares = mWidth / squareSide;
 	int numYSquares = mHeight / squareSide;
 
+	std::vector<SquareTrees> squares(numXSquares * numYSquares);
+	auto getSquare = [&] (int j, int k) -> SquareTrees* {
+		j += numXSquares / 2;
+		k += numYSquares / 2;
+		if(j < 0 || k < 0 || j >= numXSquares || k >= numYSquares)
+			return nullptr;
+		return &squares[k * numXSquares + j];
+	};
+
+	std::vector<SquareKey> passes[4];
 	for(int k = -numYSquares / 2; k < numYSquares / 2; k++) {
 		for(int j = -numXSquares / 2; j < numXSquares / 2; j++) {
-			if((k == -numYSquares / 2 && j == -numXSquares / 2) ||
-				       (k == numYSquares / 2 - 1 && j == numXSquares / 2 -1))
-				continue;
+			if(!isHomeBaseSquare(j, k))
+				passes[squarePass(j, k)].push_back(SquareKey(j, k));
+		}
+	}
 
-			int treefactor = 10 + Random::uniform() * 10;
-			for(int i = 0; i < treefactor; i++) {
-				float x = Random::uniform();
-				float y = Random::uniform();
-				float r = Random::uniform();
-
-				const float maxRadius = 8.0f;
-
-				x *= squareSide;
-				y *= squareSide;
-				x += j * squareSide;
-				y += k * squareSide;
-				r = Common::clamp(2.0f, r * maxRadius, maxRadius);
-
-				bool tooclose = false;
-				for(auto t : mTrees.query(AABB(Vector2(x, y), Vector2(maxRadius * 2.0f, maxRadius * 2.0f)))) {
-					float maxdist = r + t->getRadius();
-					if(Vector3(x, y, 0.0f).distance2(t->getPosition()) <
-							maxdist * maxdist) {
-						tooclose = true;
-						break;
-					}
-				}
-				if(tooclose) {
-					continue;
+	for(int p = 0; p < 4; p++) {
+		auto& pass = passes[p];
+		ThreadPool::getInstance()->parallelFor(pass.size(), [&] (unsigned int n) {
+			int j = pass[n].first;
+			int k = pass[n].second;
+			const SquareTrees* neighbours[8] = { nullptr };
+			int num = 0;
+			for(int dk = -1; dk <= 1; dk++) {
+				for(int dj = -1; dj <= 1; dj++) {
+					if((dj || dk) && squarePass(j + dj, k + dk) < p)
+						neighbours[num++] = getSquare(j + dj, k + dk);
 				}
+			}
+			placeTrees(j, k, neighbours, *getSquare(j, k));
+		});
+
+		for(auto& key : pass) {
+			for(auto& t : *getSquare(key.first, key.second))
+				addTree(Vector3(t.x, t.y, 0.0f), t.z);
+		}
+	}
+	std::cout << "Added " << mTrees.size() << " trees.\n";
+}
+
+bool Terrain::isStreamed() const
+{
+	return mStreamed;
+}
+
+unsigned int Terrain::getNumRegions() const
+{
+	return mRegions.size();
+}
+
+unsigned int Terrain::getRevision() const
+{
+	return mRevision;
+}
+
+// Places the trees of the squares and of the neighbours they depend on
+// that haven't been placed yet, a pass at a time.
+void Terrain::placeSquares(const std::vector<SquareKey>& squares)
+{
+	int numXSquares = mWidth / squareSide;
+	int numYSquares = mHeight / squareSide;
+	auto inside = [&] (int j, int k) {
+		return j >= -numXSquares / 2 && j < numXSquares / 2 &&
+			k >= -numYSquares / 2 && k < numYSquares / 2;
+	};
+
+	std::vector<SquareKey> passes[4];
+	std::vector<SquareKey> stack(squares);
+	while(!stack.empty()) {
+		SquareKey key = stack.back();
+		stack.pop_back();
+		if(mPlacedTrees.find(key) != mPlacedTrees.end())
+			continue;
+
+		// the entries are added here, as the map can't be modified
+		// by the threads.
+		mPlacedTrees[key];
+		int p = squarePass(key.first, key.second);
+		passes[p].push_back(key);
+		for(int dk = -1; dk <= 1; dk++) {
+			for(int dj = -1; dj <= 1; dj++) {
+				int j = key.first + dj;
+				int k = key.second + dk;
+				if((dj || dk) && squarePass(j, k) < p && inside(j, k))
+					stack.push_back(SquareKey(j, k));
+			}
+		}
+	}
 
-				// we're leaking the trees for now.
-				Tree* tree = new Tree(Vector3(x, y, 0), r);
-				bool ret = mTrees.insert(tree, Vector2(x, y));
-				if(!ret) {
-					std::cout << "Error: couldn't add tree at " << x << ", " << y << "\n";
-					assert(0);
+	for(int p = 0; p < 4; p++) {
+		auto& pass = passes[p];
+		std::sort(pass.begin(), pass.end());
+		ThreadPool::getInstance()->parallelFor(pass.size(), [&] (unsigned int n) {
+			int j = pass[n].first;
+			int k = pass[n].second;
+			const SquareTrees* neighbours[8] = { nullptr };
+			int num = 0;
+			for(int dk = -1; dk <= 1; dk++) {
+				for(int dj = -1; dj <= 1; dj++) {
+					if((dj || dk) && squarePass(j + dj, k + dk) < p) {
+						auto it = mPlacedTrees.find(SquareKey(j + dj, k + dk));
+						if(it != mPlacedTrees.end())
+							neighbours[num++] = &it->second;
+					}
 				}
 			}
+			if(!isHomeBaseSquare(j, k))
+				placeTrees(j, k, neighbours, mPlacedTrees.find(pass[n])->second);
+		});
+	}
+}
+
+// the trees on the roads are left out, as when generating the whole
+// terrain.
+void Terrain::activateSquare(const SquareKey& key)
+{
+	auto& trees = mRegions[key];
+	for(auto& t : mPlacedTrees.find(key)->second) {
+		Vector3 pos(t.x, t.y, 0.0f);
+		bool onRoad = false;
+		for(auto r : getRoadsAt(pos, t.z + mRoadWidth)) {
+			if(Math::segmentCircleIntersect(r->getStart(), r->getEnd(),
+						pos, t.z + mRoadWidth)) {
+				onRoad = true;
+				break;
+			}
 		}
+		if(onRoad)
+			continue;
+
+		Tree* tree = new Tree(pos, t.z);
+		bool ret = mTrees.insert(tree, Vector2(pos.x, pos.y));
+		assert(ret);
+		trees.push_back(tree);
 	}
-	std::cout << "Added " << mTrees.size() << " trees.\n";
 }
 
-struct GraphNode {
-	Vector2 location;
-	std::set<GraphNode*> neighbours;
+void Terrain::evictSquare(const SquareKey& key)
+{
+	auto it = mRegions.find(key);
+	assert(it != mRegions.end());
+	for(auto t : it->second) {
+		bool succ = mTrees.deleteT(t, Vector2(t->getPosition().x, t->getPosition().y));
+		assert(succ);
+	}
+	mRemovedTrees.push_back({mRegionUpdates, std::move(it->second)});
+	mRegions.erase(it);
+}
+
+// redraws the occlusion map of the squares, including the parts of the
+// trees of the neighbouring squares that reach into them.
+void Terrain::redrawOcclusion(const std::set<SquareKey>& squares)
+{
+	for(auto& key : squares) {
+		mOcclusionMap.clearArea(Vector3(key.first * squareSide, key.second * squareSide, 0.0f),
+				Vector3((key.first + 1) * squareSide, (key.second + 1) * squareSide, 0.0f));
+	}
 
-	bool operator<(const GraphNode& f) const;
-	bool operator==(const GraphNode& f) const;
-};
+	for(auto& key : squares) {
+		Vector3 center((key.first + 0.5f) * squareSide, (key.second + 0.5f) * squareSide, 0.0f);
+		for(auto t : getTreesAt(center, squareSide * 0.5f + maxTreeRadius)) {
+			mOcclusionMap.addCircle(t->getPosition(), t->getRadius());
+		}
+	}
+}
 
-bool GraphNode::operator<(const GraphNode& f) const
+void Terrain::updateRegions(const std::vector<Vector3>& positions, float radius)
 {
-	return location < f.location;
+	assert(mStreamed);
+	mRegionUpdates++;
+
+	int numXSquares = mWidth / squareSide;
+	int numYSquares = mHeight / squareSide;
+	auto inside = [&] (int j, int k) {
+		return j >= -numXSquares / 2 && j < numXSquares / 2 &&
+			k >= -numYSquares / 2 && k < numYSquares / 2;
+	};
+
+	// the squares are kept until they're a couple of squares farther
+	// away than the radius so that moving back and forth doesn't create
+	// and remove the same squares.
+	int reach = ceil(radius / squareSide);
+	int keepReach = reach + 2;
+	std::set<SquareKey> centers;
+	for(auto& p : positions) {
+		centers.insert(SquareKey(floor(p.x / squareSide), floor(p.y / squareSide)));
+	}
+
+	std::set<SquareKey> needed;
+	std::set<SquareKey> kept;
+	for(auto& c : centers) {
+		for(int dk = -keepReach; dk <= keepReach; dk++) {
+			for(int dj = -keepReach; dj <= keepReach; dj++) {
+				SquareKey key(c.first + dj, c.second + dk);
+				if(!inside(key.first, key.second))
+					continue;
+				kept.insert(key);
+				if(abs(dj) <= reach && abs(dk) <= reach &&
+						mRegions.find(key) == mRegions.end())
+					needed.insert(key);
+			}
+		}
+	}
+
+	std::vector<SquareKey> evicted;
+	for(auto& r : mRegions) {
+		if(kept.find(r.first) == kept.end())
+			evicted.push_back(r.first);
+	}
+
+	if(needed.empty() && evicted.empty())
+		return;
+
+	mRevision++;
+	placeSquares(std::vector<SquareKey>(needed.begin(), needed.end()));
+	for(auto& key : needed)
+		activateSquare(key);
+	for(auto& key : evicted)
+		evictSquare(key);
+
+	std::set<SquareKey> changed;
+	for(auto& squares : { std::vector<SquareKey>(needed.begin(), needed.end()), evicted }) {
+		for(auto& key : squares) {
+			for(int dk = -1; dk <= 1; dk++) {
+				for(int dj = -1; dj <= 1; dj++) {
+					if(inside(key.first + dj, key.second + dk))
+						changed.insert(SquareKey(key.first + dj, key.second + dk));
+				}
+			}
+		}
+	}
+	redrawOcclusion(changed);
+
+	// the placed trees are needed for the squares next to the active
+	// ones and for the neighbours they depend on
+	for(auto it = mPlacedTrees.begin(); it != mPlacedTrees.end(); ) {
+		bool used = false;
+		for(int dk = -3; !used && dk <= 3; dk++) {
+			for(int dj = -3; !used && dj <= 3; dj++) {
+				used = mRegions.find(SquareKey(it->first.first + dj,
+							it->first.second + dk)) != mRegions.end();
+			}
+		}
+		if(used)
+			++it;
+		else
+			it = mPlacedTrees.erase(it);
+	}
+
+	static const unsigned int removedTreeDelay = 16;
+	while(!mRemovedTrees.empty() && mRemovedTrees[0].first + removedTreeDelay < mRegionUpdates) {
+		for(auto t : mRemovedTrees[0].second)
+			delete t;
+		mRemovedTrees.erase(mRemovedTrees.begin());
+	}
 }
 
-bool GraphNode::operator==(const GraphNode& f) const
+void Terrain::addTree(const Vector3& pos, float radius)
 {
-	return location == f.location;
+	// we're leaking the trees for now.
+	Tree* tree = new Tree(pos, radius);
+	bool ret = mTrees.insert(tree, Vector2(pos.x, pos.y));
+	if(!ret) {
+		std::cout << "Error: couldn't add tree at " << pos.x << ", " << pos.y << "\n";
+		assert(0);
+	}
 }
 
-class RoadSolver {
+// The network of possible roads: points scattered over the map, each
+// connected to the points around it. The edges are stored in compressed
+// sparse row form; the edges of node i are mTargets[mOffsets[i]] to
+// mTargets[mOffsets[i + 1] - 1].
+class RoadGraph {
 	public:
-		void setGoalNode(const GraphNode* gl) { mGoal = gl; }
-		std::set<GraphNode> getNeighbours(const GraphNode& a);
-		int cost(const GraphNode& a, const GraphNode& b);
-		int heuristic(const GraphNode& a);
-		bool goal(const GraphNode& a);
-		void addRoad(const GraphNode& a, const GraphNode& b);
-		const std::map<Vector2, std::set<Vector2>>& getRoads() const { return mRoads; }
-
-		std::list<GraphNode> solve(const GraphNode& start);
+		// the edges must be given in both directions.
+		RoadGraph(const std::vector<Vector2>& nodes, std::vector<std::pair<int, int>>& edges);
+		// builds a road along the cheapest path between the nodes.
+		// Existing roads are much cheaper to follow than new ones.
+		void addRoad(int from, int to);
+		// the road segments with the lower node index first
+		std::vector<std::pair<int, int>> getRoads() const;
 
 	private:
-		const GraphNode* mGoal = nullptr;
-		std::map<Vector2, std::set<Vector2>> mRoads;
+		int heuristic(int node, int goal) const;
+		void setRoad(int from, int to);
+
+		const std::vector<Vector2>& mNodes;
+		std::vector<unsigned int> mOffsets;
+		std::vector<int> mTargets;
+		std::vector<int> mCosts;
+		std::vector<bool> mRoad;
+
+		// search state, reused between the searches. The costs and the
+		// previous nodes are only valid for the nodes marked with the
+		// current search number.
+		IndexedPriorityQueue mOpen;
+		std::vector<int> mCostSoFar;
+		std::vector<int> mPrevious;
+		std::vector<unsigned int> mSearched;
+		std::vector<unsigned int> mClosed;
+		unsigned int mSearch = 0;
 };
 
-std::set<GraphNode> RoadSolver::getNeighbours(const GraphNode& a)
+RoadGraph::RoadGraph(const std::vector<Vector2>& nodes, std::vector<std::pair<int, int>>& edges)
+	: mNodes(nodes),
+	mOpen(nodes.size()),
+	mCostSoFar(nodes.size()),
+	mPrevious(nodes.size()),
+	mSearched(nodes.size()),
+	mClosed(nodes.size())
 {
-	std::set<GraphNode> ret;
-	for(auto n : a.neighbours)
-		ret.insert(*n);
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	mOffsets.assign(nodes.size() + 1, 0);
+	for(auto& e : edges)
+		mOffsets[e.first + 1]++;
+	for(unsigned int i = 0; i < nodes.size(); i++)
+		mOffsets[i + 1] += mOffsets[i];
+
+	// the edges are sorted, so they're already grouped by node
+	mTargets.reserve(edges.size());
+	mCosts.reserve(edges.size());
+	for(auto& e : edges) {
+		mTargets.push_back(e.second);
+		mCosts.push_back(10 + sqrt(nodes[e.first].distance(nodes[e.second])));
+	}
+	mRoad.assign(edges.size(), false);
+}
 
-	return ret;
+int RoadGraph::heuristic(int node, int goal) const
+{
+	return 10 + sqrt(mNodes[goal].distance(mNodes[node]));
 }
 
-int RoadSolver::cost(const GraphNode& a, const GraphNode& b)
+void RoadGraph::setRoad(int from, int to)
 {
-	auto it = mRoads.find(a.location);
-	if(it != mRoads.end()) {
-		auto st = it->second;
-		if(st.find(b.location) != st.end()) {
-			return 1;
+	for(unsigned int i = mOffsets[from]; i < mOffsets[from + 1]; i++) {
+		if(mTargets[i] == to) {
+			mRoad[i] = true;
+			return;
 		}
 	}
-	float dist = a.location.distance(b.location);
-	return 10 + sqrt(dist);
+	assert(0);
 }
 
-int RoadSolver::heuristic(const GraphNode& a)
+void RoadGraph::addRoad(int from, int to)
 {
-	return 10 + sqrt(mGoal->location.distance(a.location));
-}
+	mSearch++;
+	mOpen.clear();
+	mCostSoFar[from] = 0;
+	mSearched[from] = mSearch;
+	mOpen.push(from, heuristic(from, to));
+
+	bool found = false;
+	while(!mOpen.empty()) {
+		int node = mOpen.pop();
+		if(node == to) {
+			found = true;
+			break;
+		}
+		mClosed[node] = mSearch;
 
-bool RoadSolver::goal(const GraphNode& a)
-{
-	return a.location == mGoal->location;
+		for(unsigned int i = mOffsets[node]; i < mOffsets[node + 1]; i++) {
+			int next = mTargets[i];
+			if(mClosed[next] == mSearch)
+				continue;
+
+			int cost = mCostSoFar[node] + (mRoad[i] ? 1 : mCosts[i]);
+			if(mSearched[next] != mSearch || cost < mCostSoFar[next]) {
+				mSearched[next] = mSearch;
+				mCostSoFar[next] = cost;
+				mPrevious[next] = node;
+				mOpen.push(next, cost + heuristic(next, to));
+			}
+		}
+	}
+
+	if(!found)
+		return;
+
+	for(int node = to; node != from; node = mPrevious[node]) {
+		setRoad(node, mPrevious[node]);
+		setRoad(mPrevious[node], node);
+	}
 }
 
-void RoadSolver::addRoad(const GraphNode& a, const GraphNode& b)
+std::vector<std::pair<int, int>> RoadGraph::getRoads() const
 {
-	mRoads[a.location].insert(b.location);
-	mRoads[b.location].insert(a.location);
+	std::vector<std::pair<int, int>> roads;
+	for(unsigned int i = 0; i + 1 < mOffsets.size(); i++) {
+		for(unsigned int j = mOffsets[i]; j < mOffsets[i + 1]; j++) {
+			if(mRoad[j] && (int)i < mTargets[j])
+				roads.push_back({i, mTargets[j]});
+		}
+	}
+	return roads;
 }
 
-std::list<GraphNode> RoadSolver::solve(const GraphNode& start)
+// the k points nearest to the given point, nearest first. The query area
+// is grown until it has enough points and then to the distance of the
+// farthest one, as points outside the area may be nearer than the
+// corners of the area.
+static std::vector<int> findNearest(const QuadTree<int>& tree, const std::vector<Vector2>& points,
+		const Vector2& pos, unsigned int k, float radius, float maxRadius, int exclude)
 {
-	return AStar<GraphNode>::solve([&](const GraphNode& a) { return getNeighbours(a); },
-		       [&](const GraphNode& a, const GraphNode& b) { return cost(a, b); },
-		       [&](const GraphNode& a) { return heuristic(a); },
-		       [&](const GraphNode& a) { return goal(a); },
-		       start);
+	std::vector<int> found;
+	auto query = [&] (float r) {
+		found = tree.query(AABB(pos, Vector2(r, r)));
+		found.erase(std::remove(found.begin(), found.end(), exclude), found.end());
+	};
+
+	query(radius);
+	while(found.size() < k && radius < maxRadius) {
+		radius *= 2.0f;
+		query(radius);
+	}
+
+	auto nearer = [&] (int i, int j) {
+		float d1 = pos.distance(points[i]);
+		float d2 = pos.distance(points[j]);
+		return d1 < d2 || (d1 == d2 && i < j);
+	};
+
+	if(found.size() > k) {
+		std::nth_element(found.begin(), found.begin() + k - 1, found.end(), nearer);
+		float dist = pos.distance(points[found[k - 1]]);
+		if(dist > radius) {
+			query(dist);
+			std::nth_element(found.begin(), found.begin() + k - 1, found.end(), nearer);
+		}
+		found.resize(k);
+	}
+
+	std::sort(found.begin(), found.end(), nearer);
+	return found;
 }
 
-void Terrain::addRoads()
+// the trees on the roads are only collected, as the tree index is built
+// again after generating the terrain anyway.
+void Terrain::addRoads(std::unordered_set<Tree*>& removedTrees)
 {
+	double start = Clock::getTime();
 	printf("Creating roads...\n");
-	Common::QuadTree<GraphNode*> nodes(AABB(Vector2(0, 0), Vector2(mWidth * 0.5f, mHeight * 0.5f)));
-
-	static const int squareSide = 64;
-	int numXSquares = mWidth / squareSide;
-	int numYSquares = mHeight / squareSide;
-	int numNodes = 0;
+	// the streamed terrains are large, so their road network is coarser
+	int nodeSide = mStreamed ? 256 : squareSide;
+	int numXSquares = mWidth / nodeSide;
+	int numYSquares = mHeight / nodeSide;
+	float maxRadius = std::max(mWidth, mHeight);
 
 	// create nodes
+	std::vector<Vector2> nodes;
+	QuadTree<int> nodeTree(AABB(Vector2(0, 0), Vector2(mWidth * 0.5f, mHeight * 0.5f)));
 	for(int k = -numYSquares / 2; k < numYSquares / 2; k++) {
 		for(int j = -numXSquares / 2; j < numXSquares / 2; j++) {
 			for(int i = 0; i < 3; i++) {
-				float x = Random::uniform();
-				float y = Random::uniform();
+				float x = random();
+				float y = random();
 
-				x *= squareSide;
-				y *= squareSide;
-				x += j * squareSide;
-				y += k * squareSide;
+				x *= nodeSide;
+				y *= nodeSide;
+				x += j * nodeSide;
+				y += k * nodeSide;
 
-				GraphNode* n = new GraphNode;
-				n->location = Vector2(x, y);
-				bool ret = nodes.insert(n, n->location);
+				bool ret = nodeTree.insert(nodes.size(), Vector2(x, y));
 				assert(ret);
-				numNodes++;
+				nodes.push_back(Vector2(x, y));
 			}
 		}
 	}
-
-	// find nodes' neighbours
-	int totalNodes = 0;
-	for(auto it = nodes.begin(); it != nodes.end(); ++it) {
-		totalNodes++;
-		const auto& mypos = (*it)->location;
-		if((*it)->neighbours.size() >= 20)
-			continue;
-
-		auto possibleNeighbours = nodes.query(AABB(mypos, Vector2(squareSide * 0.5f, squareSide * 0.5f)));
-		if(possibleNeighbours.size() < 3) {
-			possibleNeighbours = nodes.query(AABB(mypos, Vector2(squareSide, squareSide)));
-			if(possibleNeighbours.size() < 2) {
-				possibleNeighbours = nodes.query(AABB(mypos, Vector2(squareSide * 2.0f, squareSide * 2.0f)));
-			}
-		}
-
-		for(const auto& n : possibleNeighbours) {
-			(*it)->neighbours.insert(n);
-			n->neighbours.insert(*it);
-			if((*it)->neighbours.size() >= 20)
-				break;
+	assert(!nodes.empty());
+
+	// connect the nodes to the nodes around them, but at least to the
+	// two nearest ones
+	std::vector<std::pair<int, int>> edges;
+	for(unsigned int i = 0; i < nodes.size(); i++) {
+		auto neighbours = nodeTree.query(AABB(nodes[i], Vector2(nodeSide * 0.5f, nodeSide * 0.5f)));
+		neighbours.erase(std::remove(neighbours.begin(), neighbours.end(), (int)i), neighbours.end());
+		if(neighbours.size() < 2)
+			neighbours = findNearest(nodeTree, nodes, nodes[i], 2, nodeSide, maxRadius, i);
+
+		for(auto n : neighbours) {
+			edges.push_back({i, n});
+			edges.push_back({n, i});
 		}
 	}
-	printf("Visited %d out of %d nodes.\n", totalNodes, nodes.size());
-	assert(totalNodes == nodes.size());
+	RoadGraph graph(nodes, edges);
 
 	// assign significant nodes (road endpoints)
-	int numSignificantNodes = numNodes / 30;
-	assert(numNodes);
+	int numSignificantNodes = nodes.size() / 30;
 	assert(numSignificantNodes);
 
-	struct SignificantNode {
-		GraphNode* graphnode;
-		std::set<SignificantNode*> neighbours;
-	};
-	std::vector<SignificantNode*> sigNodes;
-
-	int nodesLeft = numNodes;
-	for(auto it = nodes.begin(); it != nodes.end(); ++it) {
-		assert(nodesLeft);
+	std::vector<int> sigNodes;
+	std::vector<Vector2> sigNodePositions;
+	QuadTree<int> sigNodeTree(AABB(Vector2(0, 0), Vector2(mWidth * 0.5f, mHeight * 0.5f)));
+	int nodesLeft = nodes.size();
+	for(unsigned int i = 0; i < nodes.size() && numSignificantNodes > 0; i++) {
 		float prob = numSignificantNodes / (float)nodesLeft;
 		nodesLeft--;
-		bool have = Random::uniform() < prob;
-		if(have) {
-			SignificantNode* snode = new SignificantNode;
-			snode->graphnode = *it;
-			sigNodes.push_back(snode);
+		if(random() < prob) {
+			sigNodeTree.insert(sigNodes.size(), nodes[i]);
+			sigNodes.push_back(i);
+			sigNodePositions.push_back(nodes[i]);
 			numSignificantNodes--;
-			if(numSignificantNodes <= 0) {
-				break;
-			}
 		}
 	}
 
 	printf("Have %zd significant nodes.\n", sigNodes.size());
+	assert(sigNodes.size() > 1);
 
-	// find significant nodes' neighbours (roads)
-	for(auto snode : sigNodes) {
-		if(snode->neighbours.size() >= 6)
-			break;
-
-		auto others = sigNodes;
-
-		std::sort(others.begin(), others.end(), [&](const SignificantNode* n1, const SignificantNode* n2) {
-				return snode->graphnode->location.distance(n1->graphnode->location) <
-					snode->graphnode->location.distance(n2->graphnode->location);
-			});
-
-		for(auto& othnode : others) {
-			if(snode->neighbours.size() >= 6)
-				break;
-
-			if(othnode == snode)
-				continue;
-
-			snode->neighbours.insert(othnode);
-			othnode->neighbours.insert(snode);
+	// connect each significant node to the nearest ones
+	std::vector<std::pair<int, int>> connections;
+	for(unsigned int i = 0; i < sigNodes.size(); i++) {
+		auto nearest = findNearest(sigNodeTree, sigNodePositions, sigNodePositions[i],
+				6, nodeSide * 4.0f, maxRadius, i);
+		for(auto n : nearest) {
+			connections.push_back({std::min<int>(i, n), std::max<int>(i, n)});
 		}
 	}
+	std::sort(connections.begin(), connections.end());
+	connections.erase(std::unique(connections.begin(), connections.end()), connections.end());
 
 	// create roads
-	assert(sigNodes.size() > 1);
-	RoadSolver r;
-	for(auto snode : sigNodes) {
-		for(auto snode2 : snode->neighbours) {
-			assert(snode != snode2);
-			r.setGoalNode(snode2->graphnode);
-			auto path = r.solve(*snode->graphnode);
-			if(path.size() > 1) {
-				auto prev = path.begin();
-				for(auto it = std::next(prev); it != path.end(); ++it) {
-					r.addRoad(*prev, *it);
-					prev = it;
-				}
-			}
-		}
+	for(auto& c : connections) {
+		graph.addRoad(sigNodes[c.first], sigNodes[c.second]);
 	}
 
 	// add roads to terrain
-	int removedTrees = 0;
-	for(const auto& road : r.getRoads()) {
-		const auto& s1 = road.first;
-		for(const auto& s2 : road.second) {
-			auto s13 = Vector3(s1.x, s1.y, 0.0f);
-			auto s23 = Vector3(s2.x, s2.y, 0.0f);
-
-			// do not add duplicate roads
-			if(s13 < s23) {
-				auto midpoint = (s1 + s2) * 0.5f;
-				auto trees = getTreesAt(Vector3(midpoint.x, midpoint.y, 0.0f), midpoint.distance(s2));
-				for(auto& t : trees) {
-					if(Math::segmentCircleIntersect(s13, s23,
-								t->getPosition(), t->getRadius() + mRoadWidth)) {
-						bool succ = mTrees.deleteT(t, Vector2(t->getPosition().x, t->getPosition().y));
-						assert(succ);
-						removedTrees++;
-					}
-				}
-
-				// leaking roads for now
-				auto robj = new Road(s13, s23);
-				bool succ = mRoads.insert(robj, AABB(midpoint, Vector2(fabs(midpoint.x - s2.x),
-								fabs(midpoint.y - s2.y))));
-				assert(succ);
+	auto roads = graph.getRoads();
+	for(const auto& road : roads) {
+		const auto& s1 = nodes[road.first];
+		const auto& s2 = nodes[road.second];
+		auto s13 = Vector3(s1.x, s1.y, 0.0f);
+		auto s23 = Vector3(s2.x, s2.y, 0.0f);
+
+		auto midpoint = (s1 + s2) * 0.5f;
+		auto trees = getTreesAt(Vector3(midpoint.x, midpoint.y, 0.0f), midpoint.distance(s2));
+		for(auto& t : trees) {
+			if(Math::segmentCircleIntersect(s13, s23,
+						t->getPosition(), t->getRadius() + mRoadWidth)) {
+				removedTrees.insert(t);
 			}
 		}
-	}
-
-	printf("Removed %d trees.\n", removedTrees);
-	printf("Have %zd road segments.\n", r.getRoads().size());
 
-	// clean up
-	for(auto n : sigNodes) {
-		delete n;
+		addRoad(s13, s23);
 	}
 
-	for(auto it = nodes.begin(); it != nodes.end(); ++it) {
-		delete *it;
-	}
-	nodes.clear();
+	printf("Removed %zd trees.\n", removedTrees.size());
+	printf("Created %zd road segments between %zd nodes in %.1f ms.\n",
+			roads.size(), nodes.size(), (Clock::getTime() - start) * 1000.0);
+}
+
+void Terrain::addRoad(const Vector3& from, const Vector3& to)
+{
+	Vector2 midpoint = Vector2((from.x + to.x) * 0.5f, (from.y + to.y) * 0.5f);
 
-	printf("Done creating roads.\n");
+	// leaking roads for now
+	auto robj = new Road(from, to);
+	bool succ = mRoads.insert(robj, AABB(midpoint, Vector2(fabs(midpoint.x - to.x),
+					fabs(midpoint.y - to.y))));
+	assert(succ);
 }
 
 std::vector<Tree*> Terrain::getTreesAt(const Vector3& v, float radius) const
@@ -1,7 +1,14 @@
 #ifndef BRIGADES_TERRAIN_H
 #define BRIGADES_TERRAIN_H
 
+#include <map>
+#include <set>
+#include <random>
+#include <string>
+#include <unordered_set>
+
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/QuadTree.h"
 #include "common/LineQuadTree.h"
@@ -9,6 +16,7 @@
 #include "common/Vehicle.h"
 
 #include "Road.h"
+#include "OcclusionMap.h"
 
 namespace Brigades {
 
@@ -19,18 +27,82 @@ class Tree : public Common::Obstacle {
 
 typedef boost::shared_ptr<Tree> TreePtr;
 
+enum class TerrainMode {
+	// the whole terrain is generated from the seed, or loaded from the
+	// cache if it was generated before
+	Generated,
+	// the roads are generated up front but the trees only around the
+	// positions given to updateRegions(), for large maps
+	Streamed,
+	// no trees or roads, e.g. for loading them from a saved game
+	Empty,
+};
+
 class Terrain {
 	public:
-		Terrain(int w, int h);
+		// the width and height must be multiples of 128.
+		Terrain(int w, int h, int seed, TerrainMode mode = TerrainMode::Generated);
 		std::vector<Tree*> getTreesAt(const Common::Vector3& v, float radius) const;
 		std::vector<Road*> getRoadsAt(const Common::Vector3& v, float radius) const;
 		float getWidth() const { return mWidth; }
 		float getHeight() const { return mHeight; }
 		float getRoadWidth() const { return mRoadWidth; }
 
+		// true if a tree is in the way of the line between the points.
+		bool lineBlocked(const Common::Vector3& from, const Common::Vector3& to) const;
+
+		bool isStreamed() const;
+		// for streamed terrain: creates the trees of the 64x64 squares
+		// within about the radius of the positions and removes the trees
+		// of the squares farther away from all of them. A square always
+		// gets the same trees, no matter when or in which order the
+		// squares are created.
+		void updateRegions(const std::vector<Common::Vector3>& positions, float radius);
+		// the number of squares with trees for streamed terrain
+		unsigned int getNumRegions() const;
+		// changes whenever trees are added or removed after the terrain
+		// was created, i.e. when streamed squares come and go.
+		unsigned int getRevision() const;
+
+		// the directory for the generated terrains. The cache is
+		// disabled if it's empty, which is the default.
+		static void setCacheDirectory(const std::string& dir);
+		// $XDG_CACHE_HOME/brigades or ~/.cache/brigades, created if
+		// needed. Empty if it's not available.
+		static std::string getDefaultCacheDirectory();
+		static const std::string& getCacheDirectory();
+		// the file this terrain is cached in; empty if the cache is
+		// disabled.
+		std::string getCacheFilename() const;
+
 	private:
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
+		// a square is identified by the coordinates of its corner in
+		// units of squares.
+		typedef std::pair<int, int> SquareKey;
+		// the trees of a square as x, y and radius, including those on
+		// roads
+		typedef std::vector<Common::Vector3> SquareTrees;
+
+		void generateTerrain();
 		void addTrees();
-		void addRoads();
+		bool isHomeBaseSquare(int j, int k) const;
+		void placeTrees(int j, int k, const SquareTrees* neighbours[8], SquareTrees& trees) const;
+		void placeSquares(const std::vector<SquareKey>& squares);
+		void activateSquare(const SquareKey& key);
+		void evictSquare(const SquareKey& key);
+		void redrawOcclusion(const std::set<SquareKey>& squares);
+		void addRoads(std::unordered_set<Tree*>& removedTrees);
+		float random();
+		bool loadCache(const std::string& filename);
+		void saveCache(const std::string& filename, const std::vector<Tree*>& trees,
+				const std::vector<Road*>& roads) const;
+		void addTree(const Common::Vector3& pos, float radius);
+		void addRoad(const Common::Vector3& from, const Common::Vector3& to);
+		void buildOcclusionMap();
 
 		float mWidth;
 		float mHeight;
@@ -39,6 +111,27 @@ class Terrain {
 		Common::Vector3 mStart;
 		Common::Vector3 mEnd;
 		float mRoadWidth;
+		int mSeed;
+		std::mt19937 mRandom;
+		bool mStreamed;
+
+		// for streamed terrain: the trees placed in the squares, kept
+		// around the active squares as their neighbours depend on them,
+		// the trees of the active squares, and the trees of the removed
+		// squares with the update they were removed on. The removed trees
+		// are freed some updates later, as the obstacle caches of the
+		// soldiers and the bullets may still refer to them.
+		std::map<SquareKey, SquareTrees> mPlacedTrees;
+		std::map<SquareKey, std::vector<Tree*>> mRegions;
+		std::vector<std::pair<unsigned int, std::vector<Tree*>>> mRemovedTrees;
+		unsigned int mRegionUpdates = 0;
+		unsigned int mRevision = 0;
+
+		// the trees don't move after creation, so sight lines can be
+		// checked against a bitmap of the area they cover.
+		OcclusionMap mOcclusionMap;
+
+		static std::string CacheDirectory;
 };
 
 }
@@ -0,0 +1,210 @@
+#include <algorithm>
+
+#include "SpriteBatch.h"
+#include "TextRenderer.h"
+
+using namespace Common;
+
+namespace Brigades {
+
+TextRenderer::TextRenderer(TTF_Font* font, boost::shared_ptr<SpriteBatch> batch)
+	: mFont(font),
+	mBatch(batch),
+	mShelfX(0),
+	mShelfY(0),
+	mShelfHeight(0)
+{
+	glGenTextures(1, &mAtlas);
+	glBindTexture(GL_TEXTURE_2D, mAtlas);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	clearAtlas();
+}
+
+TextRenderer::~TextRenderer()
+{
+	glDeleteTextures(1, &mAtlas);
+}
+
+void TextRenderer::clearAtlas()
+{
+	std::vector<uint8_t> empty(AtlasSize * AtlasSize * 4, 0);
+	glBindTexture(GL_TEXTURE_2D, mAtlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, AtlasSize, AtlasSize, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, &empty[0]);
+	mShelfX = 0;
+	mShelfY = 0;
+	mShelfHeight = 0;
+
+	// the layouts refer to the glyphs
+	mGlyphs.clear();
+	mLayouts.clear();
+	mLRU.clear();
+}
+
+const TextRenderer::Glyph* TextRenderer::getGlyph(const std::string& character)
+{
+	auto it = mGlyphs.find(character);
+	if(it != mGlyphs.end())
+		return &it->second;
+
+	SDL_Color white = { 255, 255, 255, 0 };
+	SDL_Surface* surf = TTF_RenderUTF8_Blended(mFont, character.c_str(), white);
+	if(!surf || surf->format->BytesPerPixel != 4) {
+		if(surf)
+			SDL_FreeSurface(surf);
+		Glyph g = { Rectangle(0, 0, 0, 0), 0, TTF_FontHeight(mFont) };
+		return &mGlyphs.insert(std::make_pair(character, g)).first->second;
+	}
+
+	// a transparent border around the glyph so that filtering doesn't
+	// pick up its neighbours
+	int w = surf->w;
+	int h = surf->h;
+	int pw = w + 2;
+	int ph = h + 2;
+	if(mShelfX + pw > AtlasSize) {
+		mShelfX = 0;
+		mShelfY += mShelfHeight;
+		mShelfHeight = 0;
+	}
+	if(pw > AtlasSize || mShelfY + ph > AtlasSize) {
+		SDL_FreeSurface(surf);
+		return nullptr;
+	}
+
+	// white with the alpha of the rendered glyph
+	std::vector<uint8_t> pixels(pw * ph * 4, 0);
+	SDL_LockSurface(surf);
+	for(int y = 0; y < h; y++) {
+		const Uint32* row = (const Uint32*)((const Uint8*)surf->pixels + y * surf->pitch);
+		for(int x = 0; x < w; x++) {
+			uint8_t* p = &pixels[((y + 1) * pw + x + 1) * 4];
+			p[0] = p[1] = p[2] = 255;
+			p[3] = (row[x] & surf->format->Amask) >> surf->format->Ashift;
+		}
+	}
+	SDL_UnlockSurface(surf);
+	SDL_FreeSurface(surf);
+
+	glBindTexture(GL_TEXTURE_2D, mAtlas);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, mShelfX, mShelfY, pw, ph,
+			GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	Glyph g = { Rectangle((mShelfX + 1) / float(AtlasSize), (mShelfY + 1) / float(AtlasSize),
+			w / float(AtlasSize), h / float(AtlasSize)), w, h };
+
+	mShelfX += pw;
+	mShelfHeight = std::max(mShelfHeight, ph);
+	return &mGlyphs.insert(std::make_pair(character, g)).first->second;
+}
+
+// false if the atlas is full
+bool TextRenderer::layOut(const std::string& text, Layout& layout)
+{
+	layout.quads.clear();
+	layout.width = 0.0f;
+	layout.height = 0.0f;
+
+	unsigned int i = 0;
+	while(i < text.size()) {
+		// the length of the UTF-8 sequence
+		unsigned char c = text[i];
+		unsigned int len = 1;
+		if((c & 0xe0) == 0xc0)
+			len = 2;
+		else if((c & 0xf0) == 0xe0)
+			len = 3;
+		else if((c & 0xf8) == 0xf0)
+			len = 4;
+		len = std::min<unsigned int>(len, text.size() - i);
+
+		const Glyph* g = getGlyph(text.substr(i, len));
+		if(!g)
+			return false;
+
+		GlyphQuad q = { layout.width, g };
+		layout.quads.push_back(q);
+		layout.width += g->width;
+		layout.height = std::max<float>(layout.height, g->height);
+		i += len;
+	}
+	return true;
+}
+
+const TextRenderer::Layout& TextRenderer::getLayout(const std::string& text)
+{
+	auto it = mLayouts.find(text);
+	if(it != mLayouts.end()) {
+		mLRU.splice(mLRU.begin(), mLRU, it->second.second);
+		return it->second.first;
+	}
+
+	Layout layout;
+	if(!layOut(text, layout)) {
+		// start over with an empty atlas. The quads already in the
+		// batch refer to the old glyphs, so they're drawn first.
+		mBatch->flush();
+		clearAtlas();
+		if(!layOut(text, layout)) {
+			// doesn't fit even on its own - draw what fits this
+			// time but don't keep it
+			mUncached = layout;
+			return mUncached;
+		}
+	}
+
+	if(mLayouts.size() >= MaxCachedStrings) {
+		mLayouts.erase(mLRU.back());
+		mLRU.pop_back();
+	}
+	mLRU.push_front(text);
+	return mLayouts.insert(std::make_pair(text, std::make_pair(layout, mLRU.begin()))).first->second.first;
+}
+
+void TextRenderer::addText(const std::string& text, float x, float y, float scale,
+		const Color& c, bool centered)
+{
+	if(text.empty())
+		return;
+
+	const Layout& layout = getLayout(text);
+	if(centered) {
+		x -= layout.width * scale * 0.5f;
+		y -= layout.height * scale * 0.5f;
+	}
+
+	for(auto& q : layout.quads) {
+		const Glyph& g = *q.glyph;
+		if(!g.width)
+			continue;
+
+		float gx = x + q.x * scale;
+		float gw = g.width * scale;
+		float gh = g.height * scale;
+		const Vector3 corners[4] = {
+			Vector3(gx,      y,      0.0f),
+			Vector3(gx + gw, y,      0.0f),
+			Vector3(gx + gw, y + gh, 0.0f),
+			Vector3(gx,      y + gh, 0.0f),
+		};
+		// the first row of the glyph is its top
+		const Rectangle& r = g.texcoords;
+		const float texcoords[8] = {
+			r.x,       r.y + r.h,
+			r.x + r.w, r.y + r.h,
+			r.x + r.w, r.y,
+			r.x,       r.y,
+		};
+		mBatch->addQuad(mAtlas, corners, texcoords, c);
+	}
+}
+
+unsigned int TextRenderer::getNumCachedStrings() const
+{
+	return mLayouts.size();
+}
+
+}
+
@@ -0,0 +1,87 @@
+#ifndef BRIGADES_TEXTRENDERER_H
+#define BRIGADES_TEXTRENDERER_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <SDL_ttf.h>
+
+#include "common/Color.h"
+#include "common/Rectangle.h"
+#include "common/Texture.h"
+
+namespace Brigades {
+
+class SpriteBatch;
+
+// Draws text through the sprite batch from an atlas of the glyphs of the
+// font. Each glyph is rendered once, and the layouts of the strings are
+// kept in a cache with the least recently used ones dropped, so drawing
+// the same strings over and over only adds their quads to the batch. The
+// glyphs are rendered in white and colored by the quads, and a layout
+// is drawn at any size, so neither is part of the cache key. Needs an
+// OpenGL context.
+class TextRenderer {
+	public:
+		TextRenderer(TTF_Font* font, boost::shared_ptr<SpriteBatch> batch);
+		~TextRenderer();
+
+		// as SDL_utils::drawText in screen coordinates: the text is
+		// scale times the size of the font, and the position is its
+		// lower left corner or its center.
+		void addText(const std::string& text, float x, float y, float scale,
+				const Common::Color& c, bool centered);
+		unsigned int getNumCachedStrings() const;
+
+	private:
+		struct Glyph {
+			Common::Rectangle texcoords;
+			int width;
+			int height;
+		};
+
+		struct GlyphQuad {
+			float x;
+			const Glyph* glyph;
+		};
+
+		struct Layout {
+			std::vector<GlyphQuad> quads;
+			float width;
+			float height;
+		};
+
+		typedef std::list<std::string> LRUList;
+
+		const Layout& getLayout(const std::string& text);
+		bool layOut(const std::string& text, Layout& layout);
+		const Glyph* getGlyph(const std::string& character);
+		void clearAtlas();
+
+		static const int AtlasSize = 512;
+		static const unsigned int MaxCachedStrings = 512;
+
+		TTF_Font* mFont;
+		boost::shared_ptr<SpriteBatch> mBatch;
+		GLuint mAtlas;
+		int mShelfX;
+		int mShelfY;
+		int mShelfHeight;
+		// by the UTF-8 encoded character
+		std::map<std::string, Glyph> mGlyphs;
+		// the most recently used string first
+		LRUList mLRU;
+		std::unordered_map<std::string, std::pair<Layout, LRUList::iterator>> mLayouts;
+		// the last layout that didn't fit in the atlas
+		Layout mUncached;
+};
+
+}
+
+#endif
+
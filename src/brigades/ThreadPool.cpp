@@ -0,0 +1,97 @@
+#include <cassert>
+
+#include "ThreadPool.h"
+
+namespace Brigades {
+
+boost::shared_ptr<ThreadPool> ThreadPoolInstance;
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+	: mTask(nullptr),
+	mTaskSize(0),
+	mNextIndex(0),
+	mBusyThreads(0),
+	mGeneration(0),
+	mQuit(false)
+{
+	for(unsigned int i = 1; i < numThreads; i++) {
+		mThreads.push_back(std::thread(&ThreadPool::work, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeUp.notify_all();
+	for(auto& t : mThreads) {
+		t.join();
+	}
+}
+
+unsigned int ThreadPool::getNumThreads() const
+{
+	return mThreads.size() + 1;
+}
+
+void ThreadPool::parallelFor(unsigned int n, const std::function<void (unsigned int)>& f)
+{
+	if(mThreads.empty() || n < 2) {
+		for(unsigned int i = 0; i < n; i++) {
+			f(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		assert(!mTask);
+		mTask = &f;
+		mTaskSize = n;
+		mNextIndex = 0;
+		mBusyThreads = mThreads.size();
+		mGeneration++;
+	}
+	mWakeUp.notify_all();
+
+	runTasks();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDone.wait(lock, [&] { return mBusyThreads == 0; });
+	mTask = nullptr;
+}
+
+void ThreadPool::runTasks()
+{
+	unsigned int i;
+	while((i = mNextIndex++) < mTaskSize) {
+		(*mTask)(i);
+	}
+}
+
+void ThreadPool::work()
+{
+	unsigned int generation = 0;
+	while(1) {
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeUp.wait(lock, [&] { return mQuit || mGeneration != generation; });
+			if(mQuit)
+				return;
+			generation = mGeneration;
+		}
+
+		runTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if(--mBusyThreads == 0)
+				mDone.notify_all();
+		}
+	}
+}
+
+}
+
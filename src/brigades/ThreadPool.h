@@ -0,0 +1,66 @@
+#ifndef BRIGADES_THREADPOOL_H
+#define BRIGADES_THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+#include <boost/shared_ptr.hpp>
+
+namespace Brigades {
+
+// Runs loops over independent items on a fixed set of threads. The
+// calling thread takes part in the work, so a pool of one thread runs
+// everything serially.
+class ThreadPool {
+	public:
+		static inline boost::shared_ptr<ThreadPool> getInstance();
+		static inline void setInstance(boost::shared_ptr<ThreadPool> p);
+
+		ThreadPool(unsigned int numThreads);
+		~ThreadPool();
+		unsigned int getNumThreads() const;
+
+		// calls f(i) for every i in [0, n) and returns once all calls
+		// are done. The items are handed out one by one to whichever
+		// thread is free. Must not be called from within f.
+		void parallelFor(unsigned int n, const std::function<void (unsigned int)>& f);
+
+	private:
+		void work();
+		void runTasks();
+
+		std::vector<std::thread> mThreads;
+		std::mutex mMutex;
+		std::condition_variable mWakeUp;
+		std::condition_variable mDone;
+		const std::function<void (unsigned int)>* mTask;
+		unsigned int mTaskSize;
+		std::atomic<unsigned int> mNextIndex;
+		unsigned int mBusyThreads;
+		unsigned int mGeneration;
+		bool mQuit;
+};
+
+extern boost::shared_ptr<ThreadPool> ThreadPoolInstance;
+
+boost::shared_ptr<ThreadPool> ThreadPool::getInstance()
+{
+	if(!ThreadPoolInstance) {
+		ThreadPoolInstance = boost::shared_ptr<ThreadPool>(new ThreadPool(1));
+	}
+	return ThreadPoolInstance;
+}
+
+void ThreadPool::setInstance(boost::shared_ptr<ThreadPool> p)
+{
+	ThreadPoolInstance = p;
+}
+
+}
+
+#endif
+
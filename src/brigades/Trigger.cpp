@@ -22,6 +22,11 @@ const Vector3& CircleTriggerRegion::getCenter() const
 	return mCenter;
 }
 
+float CircleTriggerRegion::getRadius() const
+{
+	return mRadius;
+}
+
 bool OnetimeTrigger::update(float time)
 {
 	return false;
@@ -39,15 +44,15 @@ bool TimedTrigger::update(float time)
 }
 
 SoundTrigger::SoundTrigger(const boost::shared_ptr<Soldier> soundmaker, float range)
-	: mSoundMaker(soundmaker),
-	mRegion(soundmaker->getPosition(), range)
+	: mRegion(soundmaker->getPosition(), range),
+	mEvent(Event::soundEvent(soundmaker))
 {
 }
 
 void SoundTrigger::tryTrigger(boost::shared_ptr<Soldier> s)
 {
-	if(mRegion.isIn(s->getPosition())) {
-		s->addEvent(boost::shared_ptr<SoundEvent>(new SoundEvent(mSoundMaker)));
+	if(!s->isDead() && mRegion.isIn(s->getPosition())) {
+		s->addEvent(mEvent);
 	}
 }
 
@@ -61,6 +66,11 @@ Vector3 SoundTrigger::getPosition()
 	return mRegion.getCenter();
 }
 
+float SoundTrigger::getRadius()
+{
+	return mRegion.getRadius();
+}
+
 WeaponPickupTrigger::WeaponPickupTrigger(WeaponPtr w, const Vector3& pos)
 	: TimedTrigger(60.0f),
 	mWeapon(w),
@@ -70,6 +80,14 @@ WeaponPickupTrigger::WeaponPickupTrigger(WeaponPtr w, const Vector3& pos)
 	mName = std::string("WeaponPickup") + std::string(mWeapon->getName());
 }
 
+// for loading saved games
+WeaponPickupTrigger::WeaponPickupTrigger()
+	: TimedTrigger(60.0f),
+	mRegion(Vector3(), 1.0f),
+	mPickedUp(false)
+{
+}
+
 void WeaponPickupTrigger::tryTrigger(SoldierPtr s)
 {
 	if(!s->isDead() &&
@@ -77,7 +95,7 @@ void WeaponPickupTrigger::tryTrigger(SoldierPtr s)
 			mRegion.isIn(s->getPosition()) &&
 			!s->hasWeaponType(mWeapon->getName()) &&
 			!mPickedUp) {
-		s->addEvent(boost::shared_ptr<WeaponPickupEvent>(new WeaponPickupEvent(mWeapon)));
+		s->addEvent(Event::weaponPickupEvent(mWeapon));
 		mPickedUp = true;
 	}
 }
@@ -97,30 +115,43 @@ Vector3 WeaponPickupTrigger::getPosition()
 	return mRegion.getCenter();
 }
 
-TriggerSystem::TriggerSystem()
+float WeaponPickupTrigger::getRadius()
+{
+	return mRegion.getRadius();
+}
+
+TriggerSystem::TriggerSystem(float width, float height)
+	: mGrid(width, height, 16.0f),
+	mMaxRadius(0.0f)
 {
 }
 
 void TriggerSystem::add(TriggerPtr t)
 {
 	mTriggers.push_back(t);
+	mGrid.add(t.get(), t->getPosition());
+	mMaxRadius = std::max(mMaxRadius, t->getRadius());
 }
 
 void TriggerSystem::update(const std::vector<SoldierPtr>& soldiers, float time)
 {
-	auto it = mTriggers.begin();
-	while(it != mTriggers.end()) {
-		for(auto s : soldiers) {
-			(*it)->tryTrigger(s);
+	if(!mTriggers.empty()) {
+		for(auto& s : soldiers) {
+			mGrid.queryCircle(s->getPosition(), mMaxRadius, [&] (Trigger* t) {
+					t->tryTrigger(s);
+					});
 		}
+	}
 
+	auto it = mTriggers.begin();
+	while(it != mTriggers.end()) {
 		if(!(*it)->update(time)) {
+			mGrid.remove(it->get(), (*it)->getPosition());
 			it = mTriggers.erase(it);
 		} else {
 			++it;
 		}
 	}
-
 }
 
 void TriggerSystem::tryOneShotTrigger(Trigger& t, const std::vector<SoldierPtr>& soldiers)
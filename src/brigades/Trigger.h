@@ -4,11 +4,15 @@
 #include <list>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/Clock.h"
 #include "common/Vector3.h"
 #include "common/Vehicle.h"
 
+#include "SpatialGrid.h"
+#include "Event.h"
+
 namespace Brigades {
 
 class Soldier;
@@ -25,8 +29,13 @@ class CircleTriggerRegion : public TriggerRegion {
 		CircleTriggerRegion(const Common::Vector3& p, float r);
 		bool isIn(const Common::Vector3& v);
 		const Common::Vector3& getCenter() const;
+		float getRadius() const;
 
 	private:
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		Common::Vector3 mCenter;
 		float mRadius;
 };
@@ -38,6 +47,7 @@ class Trigger {
 		virtual bool update(float time) = 0;
 		virtual const char* getName() = 0;
 		virtual Common::Vector3 getPosition() = 0;
+		virtual float getRadius() = 0;
 };
 
 typedef boost::shared_ptr<Trigger> TriggerPtr;
@@ -54,6 +64,11 @@ class TimedTrigger : public Trigger {
 		TimedTrigger(float time);
 		virtual bool update(float time);
 
+	protected:
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 	private:
 		Common::Countdown mTimer;
 };
@@ -64,10 +79,11 @@ class SoundTrigger : public OnetimeTrigger {
 		void tryTrigger(SoldierPtr s);
 		const char* getName();
 		Common::Vector3 getPosition();
+		float getRadius();
 
 	private:
-		const SoldierPtr mSoundMaker;
 		CircleTriggerRegion mRegion;
+		Event mEvent;
 };
 
 class WeaponPickupTrigger : public TimedTrigger {
@@ -77,8 +93,14 @@ class WeaponPickupTrigger : public TimedTrigger {
 		bool update(float time);
 		const char* getName();
 		Common::Vector3 getPosition();
+		float getRadius();
 
 	private:
+		friend class boost::serialization::access;
+		WeaponPickupTrigger();
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		WeaponPtr mWeapon;
 		const SoldierPtr mSoundMaker;
 		CircleTriggerRegion mRegion;
@@ -91,14 +113,22 @@ typedef boost::shared_ptr<WeaponPickupTrigger> WeaponPickupTriggerPtr;
 
 class TriggerSystem {
 	public:
-		TriggerSystem();
+		TriggerSystem(float width, float height);
 		void add(TriggerPtr t);
 		void update(const std::vector<SoldierPtr>& soldiers, float time);
 		const std::list<TriggerPtr> getTriggers() const;
 		void tryOneShotTrigger(Trigger& t, const std::vector<SoldierPtr>& soldiers);
 
 	private:
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		std::list<TriggerPtr> mTriggers;
+		// the triggers by their position; each soldier is only tested
+		// against the triggers near it.
+		SpatialGrid<Trigger*> mGrid;
+		float mMaxRadius;
 };
 
 }
@@ -6,6 +6,8 @@
 #include "SensorySystem.h"
 #include "DebugOutput.h"
 #include "InfoChannel.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
 
 #include "common/Random.h"
 
@@ -14,71 +16,6 @@ using namespace Common;
 namespace Brigades {
 
 
-Bullet::Bullet(const SoldierPtr shooter, const Vector3& pos, const Vector3& vel, float timeleft)
-	: mShooter(shooter),
-	mTimer(timeleft)
-{
-	mTimer.rewind();
-	mPosition = pos;
-	mVelocity = vel + shooter->getVelocity();
-	mWeapon = shooter->getCurrentWeapon();
-	assert(mWeapon);
-
-	// build cache of trees that may be in the flight line for collision detection
-	mObstacleCache = shooter->getWorld()->getTreesAt(mPosition + mVelocity * timeleft * 0.5f,
-			5.0f + mVelocity.length() * timeleft * 0.6f);
-	Vector3 endpos = mPosition + mVelocity * timeleft * 1.2f;
-
-	for(auto it = mObstacleCache.begin(); it != mObstacleCache.end(); ) {
-		if(!Math::segmentCircleIntersect(mPosition, endpos,
-					(*it)->getPosition(), (*it)->getRadius() * 2.0f)) {
-			it = mObstacleCache.erase(it);
-		} else {
-			++it;
-		}
-	}
-}
-
-const std::vector<Tree*>& Bullet::getObstacleCache() const
-{
-	return mObstacleCache;
-}
-
-void Bullet::update(float time)
-{
-	if(!isAlive())
-		return;
-
-	Entity::update(time);
-	mTimer.doCountdown(time);
-	mTimer.check();
-}
-
-bool Bullet::isAlive() const
-{
-	return mTimer.running();
-}
-
-SoldierPtr Bullet::getShooter() const
-{
-	return mShooter;
-}
-
-const WeaponPtr Bullet::getWeapon() const
-{
-	return mWeapon;
-}
-
-float Bullet::getOriginalSpeed() const
-{
-	return mWeapon->getVelocity();
-}
-
-float Bullet::getFlyTime() const
-{
-	return mTimer.getMaxTime() - mTimer.timeLeft();
-}
-
 Foxhole::Foxhole(const WorldPtr world, const Common::Vector3& pos)
 	: mWorld(world),
 	mPosition(pos),
@@ -129,19 +66,24 @@ void Timestamp::addMilliseconds(unsigned int ms)
 const float World::TimeCoefficient = 60.0f;
 
 World::World(float width, float height, float visibility, 
-		float sounddistance, UnitSize unitsize, bool dictator, Armory& armory)
-	: mTerrain(width, height),
+		float sounddistance, UnitSize unitsize, bool dictator, Armory& armory,
+		int terrainSeed, TerrainMode terrainMode)
+	: mTerrain(width, height, terrainSeed, terrainMode),
 	mMaxSoldiers(1024),
 	mMaxArmors(256),
-	mSoldierCSP(width, height, width / 32, height / 32, mMaxSoldiers),
-	mArmorCSP(width, height, width / 32, height / 32, mMaxArmors),
+	mSoldierGrid(width, height, 32.0f),
+	mArmorGrid(width, height, 32.0f),
+	mMaxVehicleRadius(0.0f),
 	mFoxholes(AABB(Vector2(0, 0), Vector2(width * 0.5f, height * 0.5f))),
 	mMaxVisibility(visibility),
 	mSoundDistance(sounddistance),
+	mBullets(width, height),
 	mTeamWon(-1),
 	mSoldiersAtStart(0),
 	mWinTimer(1.0f),
 	mReapTimer(30.0f),
+	mTerrainTimer(1.0f),
+	mTriggerSystem(width, height),
 	mSquareSide(64),
 	mArmory(armory),
 	mUnitSize(unitsize),
@@ -165,6 +107,9 @@ void World::create()
 {
 	addWalls();
 	setupSides();
+	if(mTerrain.isStreamed())
+		updateTerrainRegions();
+	updateUnitPositions();
 }
 
 // accessors
@@ -178,34 +123,58 @@ std::vector<Road*> World::getRoadsAt(const Vector3& v, float radius) const
 	return mTerrain.getRoadsAt(v, radius);
 }
 
+float World::getRoadWidth() const
+{
+	return mTerrain.getRoadWidth();
+}
+
+unsigned int World::getTerrainRevision() const
+{
+	return mTerrain.getRevision();
+}
+
 std::vector<SoldierPtr> World::getSoldiersAt(const Vector3& v, float radius)
 {
 	std::vector<SoldierPtr> res;
-	for(auto s = mSoldierCSP.queryBegin(Vector2(v.x, v.y), radius);
-			!mSoldierCSP.queryEnd();
-			s = mSoldierCSP.queryNext()) {
-		res.push_back(s);
-	}
+	float r2 = radius * radius;
+	mSoldierGrid.queryCircle(v, radius, [&] (const SoldierPtr& s) {
+			if(s->getPosition().distance2(v) <= r2)
+				res.push_back(s);
+			});
 
 	return res;
 }
 
+SoldierPtr World::getSoldier(int id) const
+{
+	auto s = mSoldiers.find(id);
+	return s ? *s : SoldierPtr();
+}
+
 std::vector<ArmorPtr> World::getArmorsAt(const Vector3& v, float radius)
 {
 	std::vector<ArmorPtr> res;
-	for(auto s = mArmorCSP.queryBegin(Vector2(v.x, v.y), radius);
-			!mArmorCSP.queryEnd();
-			s = mArmorCSP.queryNext()) {
-		res.push_back(s);
-	}
+	float r2 = radius * radius;
+	mArmorGrid.queryCircle(v, radius, [&] (const ArmorPtr& s) {
+			if(s->getPosition().distance2(v) <= r2)
+				res.push_back(s);
+			});
 
 	return res;
 }
 
-std::list<BulletPtr> World::getBulletsAt(const Common::Vector3& v, float radius) const
+std::vector<BulletQuery> World::getBulletsAt(const Common::Vector3& v, float radius) const
 {
-	/* TODO */
-	return mBullets;
+	std::vector<BulletQuery> ret;
+	mBullets.query(v, radius, [&] (unsigned int i) {
+			ret.push_back(BulletQuery(mBullets, i));
+			});
+	return ret;
+}
+
+unsigned int World::getNumBullets() const
+{
+	return mBullets.size();
 }
 
 std::vector<Foxhole*> World::getFoxholesAt(const Common::Vector3& v, float radius) const
@@ -237,7 +206,6 @@ std::vector<WallPtr> World::getWallsAt(const Common::Vector3& v, float radius) c
 std::vector<Foxhole*> World::getFoxholesInFOV(const SoldierPtr p)
 {
 	std::vector<Foxhole*> nearbytgts = getFoxholesAt(p->getPosition(), mVisibility);
-	std::vector<Tree*> nearbytrees = getTreesAt(p->getPosition(), mVisibility);
 	std::vector<Foxhole*> ret;
 
 	for(auto s : nearbytgts) {
@@ -252,15 +220,7 @@ std::vector<Foxhole*> World::getFoxholesInFOV(const SoldierPtr p)
 			continue;
 		}
 
-		bool treeblocks = false;
-		for(auto t : nearbytrees) {
-			if(Math::segmentCircleIntersect(p->getPosition(), s->getPosition(),
-						t->getPosition(), t->getRadius())) {
-				treeblocks = true;
-				break;
-			}
-		}
-		if(treeblocks) {
+		if(mTerrain.lineBlocked(p->getPosition(), s->getPosition())) {
 			continue;
 		}
 
@@ -270,7 +230,7 @@ std::vector<Foxhole*> World::getFoxholesInFOV(const SoldierPtr p)
 	return ret;
 }
 
-bool World::vehicleVisible(const SoldierPtr p, const Vehicle& s, const std::vector<Tree*>& nearbytrees) const
+bool World::vehicleVisible(const SoldierPtr p, const Vehicle& s) const
 {
 	float distToMe = Entity::distanceBetween(*p, s);
 
@@ -295,16 +255,7 @@ bool World::vehicleVisible(const SoldierPtr p, const Vehicle& s, const std::vect
 		return false;
 	}
 
-	bool treeblocks = false;
-
-	for(auto t : nearbytrees) {
-		if(Math::segmentCircleIntersect(p->getPosition(), s.getPosition(),
-					t->getPosition(), t->getRadius())) {
-			// blocked by tree
-			return false;
-		}
-	}
-	if(treeblocks) {
+	if(mTerrain.lineBlocked(p->getPosition(), s.getPosition())) {
 		return false;
 	}
 
@@ -329,36 +280,6 @@ void World::checkVehicleRoadVelocity(Armor& p)
 	p.setMaxSpeed(maxspeed);
 }
 
-std::vector<SoldierPtr> World::getSoldiersInFOV(const SoldierPtr p)
-{
-	std::vector<SoldierPtr> nearbysoldiers = getSoldiersAt(p->getPosition(), mVisibility);
-	std::vector<Tree*> nearbytrees = getTreesAt(p->getPosition(), mVisibility);
-	std::vector<SoldierPtr> ret;
-
-	for(auto s : nearbysoldiers) {
-		if(s.get() == p.get() || vehicleVisible(p, *s, nearbytrees)) {
-			ret.push_back(s);
-		}
-	}
-
-	return ret;
-}
-
-std::vector<ArmorPtr> World::getArmorsInFOV(const SoldierPtr p)
-{
-	std::vector<ArmorPtr> nearbyarmors = getArmorsAt(p->getPosition(), mVisibility);
-	std::vector<Tree*> nearbytrees = getTreesAt(p->getPosition(), mVisibility);
-	std::vector<ArmorPtr> ret;
-
-	for(auto s : nearbyarmors) {
-		if(vehicleVisible(p, *s, nearbytrees)) {
-			ret.push_back(s);
-		}
-	}
-
-	return ret;
-}
-
 int World::teamWon() const
 {
 	return mTeamWon;
@@ -377,6 +298,11 @@ const TriggerSystem& World::getTriggerSystem() const
 	return mTriggerSystem;
 }
 
+EventQueue& World::getEventQueue()
+{
+	return mEventQueue;
+}
+
 const Vector3& World::getHomeBasePosition(bool first) const
 {
 	return mHomeBasePositions[first ? 0 : 1];
@@ -406,10 +332,130 @@ Armory& World::getArmory() const
 // modifiers
 void World::update(float time)
 {
+	ProfileScope profile(ProfileSection::WorldUpdate);
+
+	propagateSounds();
+
 	// update vehicles before soldiers to ensure
 	// mounted soldiers have the correct position.
-	for(auto sit : mArmorMap) {
-		auto s = sit.second;
+	updateArmors(time);
+	updateSoldiers(time);
+
+	// keep the events of the soldiers that couldn't handle them yet
+	mEventQueue.compact();
+
+	if(mTerrain.isStreamed() && mTerrainTimer.check(time)) {
+		updateTerrainRegions();
+	}
+
+	updateVision();
+	updateBullets(time);
+
+	if(mWinTimer.check(time)) {
+		checkForWin();
+	}
+	if(mReapTimer.check(time)) {
+		reapDeadSoldiers();
+	}
+
+	updateTriggerSystem(time);
+
+	if(mUnitSize > UnitSize::Squad) {
+		for(unsigned int i = 0; i < NUM_SIDES; i++) {
+			if(mRootLeader[i]->isDead())
+				continue;
+
+			auto& c = mReinforcementTimer[i];
+			c.doCountdown(time);
+			if(c.check()) {
+				if(mSoldiersAlive[i] * 2 < mSoldiersAtStart) {
+					auto s = addUnit(UnitSize(int(mUnitSize) - 1), i, true);
+					auto rootCommandees = mRootLeader[i]->getCommandees();
+
+					if(std::find(rootCommandees.begin(), rootCommandees.end(), s) == rootCommandees.end()) {
+						// new commandee for the root leader
+						mRootLeader[i]->addCommandee(s);
+						// TODO: add event creation
+						//addAgentEvent(mRootLeader[i], handleReinforcement);
+						//mRootLeader[i]->getController()->handleReinforcement(s);
+					}
+					float oldTime = mReinforcementTimer[i].getMaxTime();
+					float newTime = oldTime + 3600.0f / TimeCoefficient;
+					mReinforcementTimer[i] = Common::Countdown(newTime);
+
+					char buf[128];
+					snprintf(buf, 127, "The %s team got reinforcement",
+							i == 0 ? "Red" : "Blue");
+					buf[127] = 0;
+					InfoChannel::getInstance()->addMessage(nullptr, Common::Color::White, buf);
+				} else {
+					c.rewind();
+				}
+			}
+		}
+	}
+
+	updateUnitPositions();
+
+	mTime.addMilliseconds(time * TimeCoefficient * 1000);
+	updateVisibility();
+}
+
+// the unit positions are read by the agents during their parallel
+// update, so they're computed here instead of when asked for
+void World::updateUnitPositions()
+{
+	for(auto& s : mSoldiers) {
+		if(!s->getLeader())
+			s->updateUnitPosition();
+	}
+}
+
+// collects the soldiers and armors whose circle the bullets cross during
+// this tick, only visiting the grid cells along each bullet's path.
+void World::findBulletHitCandidates(float time)
+{
+	mBulletSoldierHits.clear();
+	mBulletArmorHits.clear();
+
+	for(unsigned int i = 0; i < mBullets.size(); i++) {
+		const Vector3& pos = mBullets.getPosition(i);
+		Vector3 endpos = pos + mBullets.getVelocity(i) * time;
+		int side = mBullets.getShooterSide(i);
+
+		mSoldierGrid.querySegment(pos, endpos, mMaxVehicleRadius, [&] (const SoldierPtr& s) {
+				if(s->getSideNum() == side)
+					return;
+
+				if(!Math::segmentCircleIntersect(pos, endpos, s->getPosition(), s->getRadius()))
+					return;
+
+				float soldierWidth = s->getRadius();
+				auto foxhole = getFoxholeAt(s->getPosition());
+				if(foxhole) {
+					soldierWidth = soldierWidth * (1.0f - foxhole->getDepth() * 0.8f);
+					if(!Math::segmentCircleIntersect(pos, endpos, s->getPosition(), soldierWidth))
+						return;
+				}
+
+				mBulletSoldierHits.push_back(std::make_pair(i, s));
+				});
+
+		mArmorGrid.querySegment(pos, endpos, mMaxVehicleRadius, [&] (const ArmorPtr& s) {
+				if(s->getSideNum() == side)
+					return;
+
+				if(Math::segmentCircleIntersect(pos, endpos, s->getPosition(), s->getRadius()))
+					mBulletArmorHits.push_back(std::make_pair(i, s));
+				});
+	}
+}
+
+void World::updateArmors(float time)
+{
+	ProfileScope profile(ProfileSection::Vehicles);
+
+	for(auto& s : mArmors) {
 		if(!s->isDestroyed()) {
 			auto oldpos = s->getPosition();
 			assert(!isnan(s->getPosition().x));
@@ -418,7 +464,7 @@ void World::update(float time)
 			assert(!isnan(s->getPosition().x));
 			checkVehiclePosition(*s);
 			assert(!isnan(s->getPosition().x));
-			mArmorCSP.update(s, Vector2(oldpos.x, oldpos.y), Vector2(s->getPosition().x, s->getPosition().y));
+			mArmorGrid.update(s, oldpos, s->getPosition());
 
 			if(!s->getVelocity().null()) {
 				if(s->roadCheck(time)) {
@@ -427,9 +473,13 @@ void World::update(float time)
 			}
 		}
 	}
+}
 
-	for(auto sit : mSoldierMap) {
-		auto s = sit.second;
+void World::updateSoldiers(float time)
+{
+	ProfileScope profile(ProfileSection::Soldiers);
+
+	for(auto& s : mSoldiers) {
 		if(!s->isDead()) {
 			auto oldpos = s->getPosition();
 			assert(!isnan(s->getPosition().x));
@@ -443,77 +493,63 @@ void World::update(float time)
 			checkVehiclePosition(*s);
 
 			assert(!isnan(s->getPosition().x));
-			mSoldierCSP.update(s, Vector2(oldpos.x, oldpos.y), Vector2(s->getPosition().x, s->getPosition().y));
+			mSoldierGrid.update(s, oldpos, s->getPosition());
 		}
 	}
+}
 
-	auto bit = mBullets.begin();
-	while(bit != mBullets.end()) {
-		bool erase = false;
-		auto soldiers = getSoldiersAt((*bit)->getPosition(), (*bit)->getVelocity().length());
-		for(auto s : soldiers) {
-			if(mTeamWon != -1)
-				continue;
+void World::updateBullets(float time)
+{
+	ProfileScope profile(ProfileSection::Bullets);
 
-			if(s->getSideNum() == (*bit)->getShooter()->getSideNum())
-				continue;
+	findBulletHitCandidates(time);
 
-			if(s->isDead())
-				continue;
+	// the candidates are sorted by bullet index
+	auto sit = mBulletSoldierHits.begin();
+	auto ait = mBulletArmorHits.begin();
+	mSpentBullets.clear();
 
-			float soldierWidth = s->getRadius();
-			auto foxhole = getFoxholeAt(s->getPosition());
-			if(foxhole)
-				soldierWidth = soldierWidth * (1.0f - foxhole->getDepth() * 0.8f);
-
-			if(Math::segmentCircleIntersect((*bit)->getPosition(),
-						(*bit)->getPosition() + (*bit)->getVelocity() * time,
-						s->getPosition(), soldierWidth)) {
-				s->reduceHealth(s->damageFactorFromWeapon((*bit)->getWeapon()));
-				if(s->getHealth() <= 0.0f) {
-					killSoldier(s);
-				}
-				erase = true;
-				break;
-			}
-		}
+	for(unsigned int i = 0; i < mBullets.size(); i++) {
+		bool erase = false;
 
-		auto armors = getArmorsAt((*bit)->getPosition(), (*bit)->getVelocity().length());
-		for(auto s : armors) {
-			if(mTeamWon != -1)
+		for(; sit != mBulletSoldierHits.end() && sit->first == i; ++sit) {
+			auto& s = sit->second;
+			if(erase || mTeamWon != -1 || s->isDead())
 				continue;
 
-			if(s->getSideNum() == (*bit)->getShooter()->getSideNum())
-				continue;
+			s->reduceHealth(s->damageFactorFromWeapon(mBullets.getWeapon(i)));
+			if(s->getHealth() <= 0.0f) {
+				killSoldier(s);
+			}
+			erase = true;
+		}
 
-			if(s->isDestroyed())
+		bool hitArmor = false;
+		for(; ait != mBulletArmorHits.end() && ait->first == i; ++ait) {
+			auto& s = ait->second;
+			if(hitArmor || mTeamWon != -1 || s->isDestroyed())
 				continue;
 
-			float wdth = s->getRadius();
-
-			if(Math::segmentCircleIntersect((*bit)->getPosition(),
-						(*bit)->getPosition() + (*bit)->getVelocity() * time,
-						s->getPosition(), wdth)) {
-				s->reduceHealth(s->damageFactorFromWeapon((*bit)->getWeapon()));
-				if(s->getHealth() <= 0.0f) {
-					destroyArmor(s);
-				}
-				erase = true;
-				break;
+			s->reduceHealth(s->damageFactorFromWeapon(mBullets.getWeapon(i)));
+			if(s->getHealth() <= 0.0f) {
+				destroyArmor(s);
 			}
+			hitArmor = true;
 		}
+		erase = erase || hitArmor;
 
 		// have bullets pass through trees for the first 100ms of flight
-		if((*bit)->getFlyTime() > 0.1f) {
-			for(auto t : (*bit)->getObstacleCache()) {
-				if(Math::segmentCircleIntersect((*bit)->getPosition(),
-							(*bit)->getPosition() + (*bit)->getVelocity() * time,
+		if(mBullets.getFlyTime(i) > 0.1f) {
+			const Vector3& pos = mBullets.getPosition(i);
+			Vector3& vel = mBullets.getVelocity(i);
+			for(auto t : mBullets.getObstacleCache(i)) {
+				if(Math::segmentCircleIntersect(pos, pos + vel * time,
 							t->getPosition(), t->getRadius())) {
-					(*bit)->setVelocity((*bit)->getVelocity() * 0.8f);
-					float orig = (*bit)->getOriginalSpeed();
+					vel = vel * 0.8f;
+					float orig = mBullets.getOriginalSpeed(i);
 					orig *= 0.5f;
 					orig = orig * orig;
-					if((*bit)->getVelocity().length2() < orig) {
+					if(vel.length2() < orig) {
 						erase = true;
 					}
 				}
@@ -521,65 +557,108 @@ void World::update(float time)
 		}
 
 		if(!erase) {
-			(*bit)->update(time);
-			if(!(*bit)->isAlive()) {
+			if(!mBullets.update(i, time)) {
 				erase = true;
 			}
 		}
 
 		if(erase) {
-			bit = mBullets.erase(bit);
-		} else {
-			++bit;
+			mSpentBullets.push_back(i);
 		}
 	}
 
-	if(mWinTimer.check(time)) {
-		checkForWin();
+	// remove from the back so that the bullet swapped in place
+	// of a removed one is never one that should be removed as well
+	for(auto it = mSpentBullets.rbegin(); it != mSpentBullets.rend(); ++it) {
+		mBullets.remove(*it);
 	}
-	if(mReapTimer.check(time)) {
-		reapDeadSoldiers();
+}
+
+void World::requestVisionUpdate(const SoldierPtr s)
+{
+	mPendingVisionUpdates.push_back(s);
+}
+
+// updates the field of view of all soldiers that requested it during
+// this tick. Nearby observers share the query for potentially visible
+// soldiers and armors, and sight lines are checked against the occlusion
+// map. The groups are processed in parallel without modifying the world,
+// after which the results are handed to the sensory systems in order.
+void World::updateVision()
+{
+	ProfileScope profile(ProfileSection::Vision);
+
+	static const float groupSize = 32.0f;
+
+	auto groupOf = [&] (const SoldierPtr& s) {
+		return std::make_pair(int(floor(s->getPosition().x / groupSize)),
+				int(floor(s->getPosition().y / groupSize)));
+	};
+
+	std::stable_sort(mPendingVisionUpdates.begin(), mPendingVisionUpdates.end(),
+			[&] (const SoldierPtr& s1, const SoldierPtr& s2) {
+			return groupOf(s1) < groupOf(s2);
+			});
+
+	unsigned int numObservers = mPendingVisionUpdates.size();
+	mVisionGroups.clear();
+	for(unsigned int i = 0; i < numObservers; ) {
+		unsigned int j = i + 1;
+		auto group = groupOf(mPendingVisionUpdates[i]);
+		while(j < numObservers && groupOf(mPendingVisionUpdates[j]) == group)
+			j++;
+		mVisionGroups.push_back(std::make_pair(i, j));
+		i = j;
 	}
 
-	updateTriggerSystem(time);
+	if(mVisionResults.size() < numObservers)
+		mVisionResults.resize(numObservers);
 
-	if(mUnitSize > UnitSize::Squad) {
-		for(unsigned int i = 0; i < NUM_SIDES; i++) {
-			if(mRootLeader[i]->isDead())
-				continue;
+	float vis2 = mVisibility * mVisibility;
+	// covers the visibility of every observer in the group
+	float queryRadius = mVisibility + groupSize * 0.71f;
 
-			auto& c = mReinforcementTimer[i];
-			c.doCountdown(time);
-			if(c.check()) {
-				if(mSoldiersAlive[i] * 2 < mSoldiersAtStart) {
-					auto s = addUnit(UnitSize(int(mUnitSize) - 1), i, true);
-					auto rootCommandees = mRootLeader[i]->getCommandees();
+	ThreadPool::getInstance()->parallelFor(mVisionGroups.size(), [&] (unsigned int g) {
+		unsigned int first = mVisionGroups[g].first;
+		unsigned int last = mVisionGroups[g].second;
+		auto group = groupOf(mPendingVisionUpdates[first]);
+		Vector3 center((group.first + 0.5f) * groupSize, (group.second + 0.5f) * groupSize, 0.0f);
+		auto nearbysoldiers = getSoldiersAt(center, queryRadius);
+		auto nearbyarmors = getArmorsAt(center, queryRadius);
 
-					if(std::find(rootCommandees.begin(), rootCommandees.end(), s) == rootCommandees.end()) {
-						// new commandee for the root leader
-						mRootLeader[i]->addCommandee(s);
-						// TODO: add event creation
-						//addAgentEvent(mRootLeader[i], handleReinforcement);
-						//mRootLeader[i]->getController()->handleReinforcement(s);
-					}
-					float oldTime = mReinforcementTimer[i].getMaxTime();
-					float newTime = oldTime + 3600.0f / TimeCoefficient;
-					mReinforcementTimer[i] = Common::Countdown(newTime);
+		for(unsigned int i = first; i < last; i++) {
+			const SoldierPtr& p = mPendingVisionUpdates[i];
+			VisionResult& res = mVisionResults[i];
+			res.soldiers.clear();
+			res.armors.clear();
 
-					char buf[128];
-					snprintf(buf, 127, "The %s team got reinforcement",
-							i == 0 ? "Red" : "Blue");
-					buf[127] = 0;
-					InfoChannel::getInstance()->addMessage(nullptr, Common::Color::White, buf);
-				} else {
-					c.rewind();
+			if(p->isDead())
+				continue;
+
+			for(auto& s : nearbysoldiers) {
+				if(s.get() == p.get() ||
+						(p->getPosition().distance2(s->getPosition()) <= vis2 &&
+						 vehicleVisible(p, *s))) {
+					res.soldiers.push_back(s);
+				}
+			}
+
+			for(auto& s : nearbyarmors) {
+				if(p->getPosition().distance2(s->getPosition()) <= vis2 &&
+						vehicleVisible(p, *s)) {
+					res.armors.push_back(s);
 				}
 			}
 		}
+	});
+
+	for(unsigned int i = 0; i < numObservers; i++) {
+		const SoldierPtr& p = mPendingVisionUpdates[i];
+		if(!p->isDead())
+			p->getSensorySystem()->updateFOV(mVisionResults[i].soldiers, mVisionResults[i].armors);
 	}
 
-	mTime.addMilliseconds(time * TimeCoefficient * 1000);
-	updateVisibility();
+	mPendingVisionUpdates.clear();
 }
 
 void World::updateVisibility()
@@ -612,13 +691,29 @@ float World::getTimeCoefficient() const
 void World::addBullet(const WeaponPtr w, const SoldierPtr s, const Vector3& dir)
 {
 	float time = w->getRange() / w->getVelocity();
-	mBullets.push_back(BulletPtr(new Bullet(s,
-				s->getPosition(),
-				dir.normalized() * w->getVelocity(),
-				time)));
-	auto nearbySoldiers = getSoldiersAt(s->getPosition(), getShootSoundHearingDistance());
-	SoundTrigger trigger(s, getShootSoundHearingDistance());
-	mTriggerSystem.tryOneShotTrigger(trigger, nearbySoldiers);
+	const Vector3& pos = s->getPosition();
+	Vector3 vel = dir.normalized() * w->getVelocity() + s->getVelocity();
+	assert(s->getCurrentWeapon());
+	unsigned int i = mBullets.add(s->getCurrentWeapon(), s->getSideNum(), pos, vel, time);
+	buildObstacleCache(i, time);
+
+	addSound(s, getShootSoundHearingDistance());
+}
+
+// build cache of trees that may be in the flight line for collision detection
+void World::buildObstacleCache(unsigned int bullet, float time)
+{
+	auto& cache = mBullets.getObstacleCache(bullet);
+	const Vector3& pos = mBullets.getPosition(bullet);
+	const Vector3& vel = mBullets.getVelocity(bullet);
+	Vector3 endpos = pos + vel * time * 1.2f;
+	cache.clear();
+	for(auto t : getTreesAt(pos + vel * time * 0.5f, 5.0f + vel.length() * time * 0.6f)) {
+		if(Math::segmentCircleIntersect(pos, endpos,
+					t->getPosition(), t->getRadius() * 2.0f)) {
+			cache.push_back(t);
+		}
+	}
 }
 
 void World::dig(float time, const Common::Vector3& pos)
@@ -643,9 +738,68 @@ void World::createMovementSound(const SoldierPtr s)
 	float dist = getShootSoundHearingDistance() * 0.3f;
 	if(s->mounted())
 		dist *= 3.0f;
-	auto nearbySoldiers = getSoldiersAt(s->getPosition(), dist);
-	SoundTrigger trigger(s, dist);
-	mTriggerSystem.tryOneShotTrigger(trigger, nearbySoldiers);
+	addSound(s, dist);
+}
+
+void World::addSound(const SoldierPtr s, float range)
+{
+	mPendingSounds.push_back(std::make_pair(s, range));
+}
+
+// lets the soldiers hear the sounds made since the last update. Several
+// sounds made by one soldier are heard as one, and sound makers close to
+// each other share the query for listeners.
+void World::propagateSounds()
+{
+	static const float groupSize = 32.0f;
+
+	if(mPendingSounds.empty())
+		return;
+
+	auto groupOf = [&] (const SoldierPtr& s) {
+		return std::make_pair(int(floor(s->getPosition().x / groupSize)),
+				int(floor(s->getPosition().y / groupSize)));
+	};
+
+	std::sort(mPendingSounds.begin(), mPendingSounds.end(),
+			[&] (const std::pair<SoldierPtr, float>& s1, const std::pair<SoldierPtr, float>& s2) {
+			auto g1 = groupOf(s1.first);
+			auto g2 = groupOf(s2.first);
+			if(g1 != g2)
+				return g1 < g2;
+			return s1.first->getID() < s2.first->getID();
+			});
+
+	// keep the loudest sound of each sound maker
+	unsigned int numSounds = 0;
+	for(unsigned int i = 0; i < mPendingSounds.size(); i++) {
+		if(numSounds > 0 && mPendingSounds[numSounds - 1].first == mPendingSounds[i].first) {
+			mPendingSounds[numSounds - 1].second = std::max(mPendingSounds[numSounds - 1].second,
+					mPendingSounds[i].second);
+		} else {
+			mPendingSounds[numSounds++] = mPendingSounds[i];
+		}
+	}
+	mPendingSounds.resize(numSounds);
+
+	auto it = mPendingSounds.begin();
+	while(it != mPendingSounds.end()) {
+		auto group = groupOf(it->first);
+		auto groupEnd = it;
+		float maxRange = 0.0f;
+		for(; groupEnd != mPendingSounds.end() && groupOf(groupEnd->first) == group; ++groupEnd) {
+			maxRange = std::max(maxRange, groupEnd->second);
+		}
+
+		Vector3 center((group.first + 0.5f) * groupSize, (group.second + 0.5f) * groupSize, 0.0f);
+		auto listeners = getSoldiersAt(center, maxRange + groupSize * 0.71f);
+		for(; it != groupEnd; ++it) {
+			SoundTrigger trigger(it->first, it->second);
+			mTriggerSystem.tryOneShotTrigger(trigger, listeners);
+		}
+	}
+
+	mPendingSounds.clear();
 }
 
 void World::setSoldierListener(SoldierListener* l)
@@ -696,7 +850,7 @@ void World::setupSides()
 
 SoldierPtr World::addSoldier(bool first, SoldierRank rank, bool dictator, int sector)
 {
-	if(mSoldierMap.size() >= mMaxSoldiers) {
+	if(mSoldiers.size() >= mMaxSoldiers) {
 		assert(0);
 		throw std::runtime_error("Too many soldiers in the world");
 	}
@@ -724,14 +878,15 @@ SoldierPtr World::addSoldier(bool first, SoldierRank rank, bool dictator, int se
 	pos.y += rand() % 30 - 15;
 
 	s->setPosition(pos);
-	mSoldierCSP.add(s, Vector2(s->getPosition().x, s->getPosition().y));
-	mSoldierMap.insert(std::make_pair(s->getID(), s));
+	mSoldierGrid.add(s, s->getPosition());
+	mMaxVehicleRadius = std::max(mMaxVehicleRadius, s->getRadius());
+	mSoldiers.insert(s->getID(), s);
 	return s;
 }
 
 ArmorPtr World::addArmor(bool first, int sector)
 {
-	if(mArmorMap.size() >= mMaxArmors) {
+	if(mArmors.size() >= mMaxArmors) {
 		assert(0);
 		throw std::runtime_error("Too many soldiers in the world");
 	}
@@ -747,8 +902,9 @@ ArmorPtr World::addArmor(bool first, int sector)
 	pos.y += rand() % 30 - 15;
 
 	s->setPosition(pos);
-	mArmorCSP.add(s, Vector2(s->getPosition().x, s->getPosition().y));
-	mArmorMap.insert(std::make_pair(s->getID(), s));
+	mArmorGrid.add(s, s->getPosition());
+	mMaxVehicleRadius = std::max(mMaxVehicleRadius, s->getRadius());
+	mArmors.insert(s->getID(), s);
 	return s;
 }
 
@@ -869,11 +1025,9 @@ void World::destroyArmor(ArmorPtr a)
 
 void World::updateTriggerSystem(float time)
 {
-	std::vector<SoldierPtr> soldiers;
-	for(auto s : mSoldierMap) {
-		soldiers.push_back(s.second);
-	}
-	mTriggerSystem.update(soldiers, time);
+	ProfileScope profile(ProfileSection::Triggers);
+
+	mTriggerSystem.update(mSoldiers.values(), time);
 }
 
 SoldierPtr World::addCompany(int side, bool reuseLeader)
@@ -967,31 +1121,38 @@ void World::setHomeBasePositions()
 	mHomeBasePositions[1] = Vector3(x, y, 0);
 }
 
-void World::reapDeadSoldiers()
+// the trees are needed as far as the soldiers can see, and a bit
+// farther for the units moving until the next update.
+void World::updateTerrainRegions()
 {
-	{
-		auto it = mSoldierMap.begin();
-		while(it != mSoldierMap.end()) {
-			if(it->second->isDead()) {
-				mSoldierCSP.remove(it->second, Vector2(it->second->getPosition().x, it->second->getPosition().y));
-				it = mSoldierMap.erase(it);
-			} else {
-				++it;
-			}
-		}
+	std::vector<Vector3> positions;
+	for(auto& s : mSoldiers) {
+		if(!s->isDead())
+			positions.push_back(s->getPosition());
 	}
-
-	{
-		auto it = mArmorMap.begin();
-		while(it != mArmorMap.end()) {
-			if(it->second->isDestroyed()) {
-				mArmorCSP.remove(it->second, Vector2(it->second->getPosition().x, it->second->getPosition().y));
-				it = mArmorMap.erase(it);
-			} else {
-				++it;
-			}
-		}
+	for(auto& a : mArmors) {
+		if(!a->isDestroyed())
+			positions.push_back(a->getPosition());
 	}
+	mTerrain.updateRegions(positions, mMaxVisibility + mSquareSide);
+}
+
+void World::reapDeadSoldiers()
+{
+	mSoldiers.removeIf([&] (const SoldierPtr& s) {
+			if(!s->isDead())
+				return false;
+			mSoldierGrid.remove(s, s->getPosition());
+			mEventQueue.remove(s->getID());
+			return true;
+			});
+
+	mArmors.removeIf([&] (const ArmorPtr& a) {
+			if(!a->isDestroyed())
+				return false;
+			mArmorGrid.remove(a, a->getPosition());
+			return true;
+			});
 }
 
 }
@@ -8,18 +8,21 @@
 
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/serialization/access.hpp>
 
 #include "common/Clock.h"
 #include "common/Rectangle.h"
 #include "common/Vehicle.h"
 #include "common/Steering.h"
-#include "common/CellSpacePartition.h"
 
 #include "Soldier.h"
 #include "Side.h"
 #include "Armory.h"
 #include "Trigger.h"
 #include "Terrain.h"
+#include "BulletStore.h"
+#include "SpatialGrid.h"
+#include "SlotMap.h"
 
 #define NUM_SIDES 2
 
@@ -32,26 +35,6 @@ typedef boost::shared_ptr<World> WorldPtr;
 
 typedef boost::shared_ptr<Common::Wall> WallPtr;
 
-class Bullet : public Common::Entity {
-	public:
-		Bullet(const SoldierPtr shooter, const Common::Vector3& pos, const Common::Vector3& vel, float timeleft);
-		void update(float time) override;
-		bool isAlive() const;
-		SoldierPtr getShooter() const;
-		const WeaponPtr getWeapon() const;
-		float getOriginalSpeed() const;
-		float getFlyTime() const;
-		const std::vector<Tree*>& getObstacleCache() const;
-
-	private:
-		SoldierPtr mShooter;
-		Common::Countdown mTimer;
-		WeaponPtr mWeapon;
-		std::vector<Tree*> mObstacleCache;
-};
-
-typedef boost::shared_ptr<Bullet> BulletPtr;
-
 enum class UnitSize {
 	Squad,
 	Platoon,
@@ -82,6 +65,9 @@ struct Timestamp {
 
 	int secondDifferenceTo(const Timestamp& ts) const;
 	void addMilliseconds(unsigned int ms);
+
+	template<class Archive>
+	void serialize(Archive& ar, const unsigned int version);
 };
 
 class SoldierListener {
@@ -94,28 +80,34 @@ class SoldierListener {
 class World : public boost::enable_shared_from_this<World> {
 
 	public:
+		// the terrain is empty when it's loaded from a saved game.
 		World(float width, float height, float visibility,
-				float sounddistance, UnitSize unitsize, bool dictator, Armory& armory);
+				float sounddistance, UnitSize unitsize, bool dictator, Armory& armory,
+				int terrainSeed, TerrainMode terrainMode = TerrainMode::Generated);
 		void create();
 
 		// accessors
 		std::vector<Tree*> getTreesAt(const Common::Vector3& v, float radius) const;
 		std::vector<Road*> getRoadsAt(const Common::Vector3& v, float radius) const;
+		float getRoadWidth() const;
+		// see Terrain::getRevision()
+		unsigned int getTerrainRevision() const;
 		std::vector<SoldierPtr> getSoldiersAt(const Common::Vector3& v, float radius);
+		SoldierPtr getSoldier(int id) const;
 		std::vector<ArmorPtr> getArmorsAt(const Common::Vector3& v, float radius);
-		std::list<BulletPtr> getBulletsAt(const Common::Vector3& v, float radius) const;
+		std::vector<BulletQuery> getBulletsAt(const Common::Vector3& v, float radius) const;
+		unsigned int getNumBullets() const;
 		std::vector<Foxhole*> getFoxholesAt(const Common::Vector3& v, float radius) const;
 		Foxhole* getFoxholeAt(const Common::Vector3& pos);
 		float getWidth() const;
 		float getHeight() const;
 		SidePtr getSide(bool first) const;
 		std::vector<WallPtr> getWallsAt(const Common::Vector3& v, float radius) const;
-		std::vector<SoldierPtr> getSoldiersInFOV(const SoldierPtr p);
-		std::vector<ArmorPtr> getArmorsInFOV(const SoldierPtr p);
 		std::vector<Foxhole*> getFoxholesInFOV(const SoldierPtr p);
 		int teamWon() const; // -1 => no one has won yet, -2 => no teams alive
 		int soldiersAlive(int t) const;
 		const TriggerSystem& getTriggerSystem() const;
+		EventQueue& getEventQueue();
 		const Common::Vector3& getHomeBasePosition(bool first) const;
 		float getVisibility() const;
 		float getVisibilityFactor() const;
@@ -130,9 +122,16 @@ class World : public boost::enable_shared_from_this<World> {
 		void addBullet(const WeaponPtr w, const SoldierPtr s, const Common::Vector3& dir);
 		void dig(float time, const Common::Vector3& pos);
 		void createMovementSound(const SoldierPtr s);
+		void requestVisionUpdate(const SoldierPtr s);
 		void setSoldierListener(SoldierListener* l);
 
 	private:
+		friend class boost::serialization::access;
+		// the world is loaded in place after construction; the soldier
+		// listener is not saved.
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		void setupSides();
 		SoldierPtr addUnit(UnitSize u, unsigned int side, bool reuseLeader = false);
 		SoldierPtr addSoldier(bool first, SoldierRank rank, bool dictator, int sector);
@@ -152,31 +151,57 @@ class World : public boost::enable_shared_from_this<World> {
 		void addDictator(int side);
 		void setHomeBasePositions();
 		void reapDeadSoldiers();
-		bool vehicleVisible(const SoldierPtr p, const Common::Vehicle& s,
-				const std::vector<Tree*>& nearbytrees) const;
+		bool vehicleVisible(const SoldierPtr p, const Common::Vehicle& s) const;
+		void updateVision();
+		void updateUnitPositions();
 		void checkVehicleRoadVelocity(Armor& p);
+		void updateArmors(float time);
+		void updateSoldiers(float time);
+		void updateBullets(float time);
+		void findBulletHitCandidates(float time);
+		void buildObstacleCache(unsigned int bullet, float time);
+		void addSound(const SoldierPtr s, float range);
+		void propagateSounds();
+		void updateTerrainRegions();
 
 		Terrain mTerrain;
 		const unsigned int mMaxSoldiers;
 		const unsigned int mMaxArmors;
 		SidePtr mSides[NUM_SIDES];
-		Common::CellSpacePartition<SoldierPtr> mSoldierCSP;
-		Common::CellSpacePartition<ArmorPtr> mArmorCSP;
-		std::map<int, SoldierPtr> mSoldierMap;
-		std::map<int, ArmorPtr> mArmorMap;
+		SpatialGrid<SoldierPtr> mSoldierGrid;
+		SpatialGrid<ArmorPtr> mArmorGrid;
+		float mMaxVehicleRadius;
+		SlotMap<SoldierPtr> mSoldiers;
+		SlotMap<ArmorPtr> mArmors;
 		Common::QuadTree<Foxhole*> mFoxholes;
 		std::vector<WallPtr> mWalls;
 		float mVisibility;
 		float mMaxVisibility;
 		float mSoundDistance;
-		std::list<BulletPtr> mBullets;
+		BulletStore mBullets;
+		// hit candidates of the bullets for one tick as (bullet, target)
+		std::vector<std::pair<unsigned int, SoldierPtr>> mBulletSoldierHits;
+		std::vector<std::pair<unsigned int, ArmorPtr>> mBulletArmorHits;
+		std::vector<unsigned int> mSpentBullets;
+		std::vector<SoldierPtr> mPendingVisionUpdates;
+		// ranges of mPendingVisionUpdates that share a vision query
+		std::vector<std::pair<unsigned int, unsigned int>> mVisionGroups;
+		struct VisionResult {
+			std::vector<SoldierPtr> soldiers;
+			std::vector<ArmorPtr> armors;
+		};
+		std::vector<VisionResult> mVisionResults;
+		// sounds made since the last update as (sound maker, range)
+		std::vector<std::pair<SoldierPtr, float>> mPendingSounds;
 		int mTeamWon;
 		int mSoldiersAlive[NUM_SIDES];
 		int mSoldiersAtStart;
 		SoldierPtr mRootLeader[NUM_SIDES];
 		Common::SteadyTimer mWinTimer;
 		Common::SteadyTimer mReapTimer;
+		Common::SteadyTimer mTerrainTimer;
 		TriggerSystem mTriggerSystem;
+		EventQueue mEventQueue;
 		Common::Vector3 mHomeBasePositions[NUM_SIDES];
 		int mSquareSide;
 		Armory& mArmory;
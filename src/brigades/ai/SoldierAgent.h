@@ -21,6 +21,10 @@ class SoldierAgent : public Brigades::SoldierAgent {
 		virtual void newCommunication(const SoldierCommunication& comm) override;
 
 	private:
+		friend class boost::serialization::access;
+		template<class Archive>
+		void serialize(Archive& ar, const unsigned int version);
+
 		std::vector<SoldierAction> mPendingActions;
 		Common::Vector3 mMoveTarget;
 		Common::Vector3 mMountTarget;
@@ -0,0 +1,356 @@
+#include <iostream>
+#include <fstream>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/Clock.h"
+
+#include "Scenario.h"
+#include "World.h"
+#include "Terrain.h"
+#include "Profiler.h"
+#include "AgentDirectory.h"
+#include "SoldierAction.h"
+#include "Benchmarks.h"
+#include "ThreadPool.h"
+#include "Savegame.h"
+#include "Replay.h"
+
+using namespace Brigades;
+using namespace Common;
+
+static void usage(const char* pn)
+{
+	std::cerr << "Usage: " << pn << " [options]\n\n"
+		<< "Runs a battle without graphics as fast as possible.\n\n"
+		<< "Options:\n"
+		<< "\t--arcade         arcade mode\n"
+		<< "\t--skirmish       squad-size battle on a smaller map\n"
+		<< "\t--map-size <m>   width and height of the map, a multiple of 128\n"
+		<< "\t                 and at least 384\n"
+		<< "\t-s <seed>        random seed\n"
+		<< "\t-t <timestep>    simulation timestep in seconds (default: 0.02)\n"
+		<< "\t-l <seconds>     stop after this much simulation time (default: 3600)\n"
+		<< "\t-b <benchmark>   run a benchmark instead of a battle\n"
+		<< "\t--threads <n>    number of threads for the simulation (default: 1)\n"
+		<< "\t--load <file>    continue a saved battle\n"
+		<< "\t--save <file>    save the battle to the file when done\n"
+		<< "\t--save-interval <seconds>\n"
+		<< "\t                 also save every this many seconds of simulation time\n"
+		<< "\t--record <file>  record a replay of the battle\n"
+		<< "\t--replay <file>  re-simulate a recorded battle\n"
+		<< "\t--profile <file> write the time spent in each part of the simulation\n"
+		<< "\t                 as CSV, or as a Chrome trace if the file ends in .json\n"
+		<< "\t--no-terrain-cache\n"
+		<< "\t                 always generate the terrain\n";
+}
+
+static void saveGame(const char* filename, const Scenario& scenario,
+		const World& world, const AgentDirectory& agents)
+{
+	double start = Clock::getTime();
+	std::ofstream os(filename, std::ios::binary);
+	Savegame::save(os, scenario, world, agents);
+	os.close();
+	if(!os) {
+		std::cerr << "Could not save to " << filename << ".\n";
+		exit(1);
+	}
+	std::cout << "Saved " << filename << " in " << (Clock::getTime() - start) * 1000.0 << " ms\n";
+}
+
+static const char* outcomeToString(int teamWon)
+{
+	switch(teamWon) {
+		case 0:
+			return "Red team wins";
+		case 1:
+			return "Blue team wins";
+		case -2:
+			return "Draw";
+		default:
+			return "No winner";
+	}
+}
+
+static void writeProfile(const char* filename)
+{
+	auto profiler = Profiler::getInstance();
+	unsigned int frames = std::min(profiler->getNumFrames(), 300u);
+	std::cout << "Profile of the last " << frames << " ticks (average / p99 ms):\n";
+	for(int i = 0; i < int(ProfileSection::NumSections); i++) {
+		auto stats = profiler->getStats(ProfileSection(i));
+		if(stats.p99 > 0.0f) {
+			printf("\t%-28s %8.3f %8.3f\n", Profiler::getSectionName(ProfileSection(i)),
+					stats.average, stats.p99);
+		}
+	}
+
+	if(!profiler->writeFile(filename)) {
+		std::cerr << "Could not write " << filename << ".\n";
+		exit(1);
+	}
+	std::cout << "Wrote the profile to " << filename << "\n";
+}
+
+static long getFileSize(const char* filename)
+{
+	std::ifstream is(filename, std::ios::binary | std::ios::ate);
+	return is ? (long)is.tellg() : 0;
+}
+
+static int replay(const char* filename)
+{
+	std::ifstream is(filename, std::ios::binary);
+	ReplayPlayer player(is);
+	bool arcade, skirmish;
+	int seed;
+	int mapSize;
+	if(!player.readHeader(arcade, skirmish, seed, mapSize)) {
+		std::cerr << "Could not read the replay " << filename << ".\n";
+		return 1;
+	}
+
+	Scenario scenario(arcade, skirmish);
+	scenario.setMapSize(mapSize);
+	srand(seed);
+	std::cout << "Seed: " << seed << "\n";
+
+	WorldPtr world = scenario.createWorld(seed);
+	AgentDirectory agents;
+	world->setSoldierListener(&agents);
+	SoldierAction::setAgentDirectory(&agents);
+	world->create();
+
+	double startTime = Clock::getTime();
+	try {
+		while(player.tick(world, agents))
+			;
+	} catch(std::exception& e) {
+		std::cerr << "Could not replay " << filename << ": " << e.what() << "\n";
+		return 1;
+	}
+	double wallTime = Clock::getTime() - startTime;
+
+	unsigned int ticks = player.getNumTicks();
+	std::cout << "Ticks: " << ticks << "\n";
+	std::cout << "Simulation time: " << world->getCurrentTimeAsString() << "\n";
+	std::cout << "Wall-clock time: " << wallTime << " s\n";
+	std::cout << "Ticks per second: " << (wallTime > 0.0 ? ticks / wallTime : 0.0) << "\n";
+	std::cout << "Outcome: " << outcomeToString(world->teamWon()) << "\n";
+	std::cout << "Desyncs: " << player.getNumDesyncs() << "\n";
+
+	world->setSoldierListener(nullptr);
+	SoldierAction::setAgentDirectory(nullptr);
+	return player.getNumDesyncs() ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	bool arcade = false;
+	bool skirmish = false;
+	float timestep = 0.02f;
+	float timelimit = 3600.0f;
+	const char* benchmark = nullptr;
+	int threads = 1;
+	const char* loadFile = nullptr;
+	const char* saveFile = nullptr;
+	float saveInterval = 0.0f;
+	const char* recordFile = nullptr;
+	const char* replayFile = nullptr;
+	bool terrainCache = true;
+	int mapSize = 0;
+	const char* profileFile = nullptr;
+
+	int seed = time(NULL);
+
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--skirmish")) {
+			skirmish = true;
+		}
+		else if(!strcmp(argv[i], "--arcade")) {
+			arcade = true;
+		}
+		else if(!strcmp(argv[i], "--no-terrain-cache")) {
+			terrainCache = false;
+		}
+		else if(!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0]);
+			exit(0);
+		}
+		else if(!strcmp(argv[i], "-s") || !strcmp(argv[i], "-t") || !strcmp(argv[i], "-l") ||
+				!strcmp(argv[i], "-b") || !strcmp(argv[i], "--threads") ||
+				!strcmp(argv[i], "--load") || !strcmp(argv[i], "--save") ||
+				!strcmp(argv[i], "--save-interval") || !strcmp(argv[i], "--record") ||
+				!strcmp(argv[i], "--replay") || !strcmp(argv[i], "--map-size") ||
+				!strcmp(argv[i], "--profile")) {
+			const char* opt = argv[i];
+			i++;
+			if(i == argc) {
+				std::cerr << opt << " requires a parameter.\n";
+				exit(1);
+			}
+			if(!strcmp(opt, "-s")) {
+				seed = atoi(argv[i]);
+			} else if(!strcmp(opt, "-t")) {
+				timestep = atof(argv[i]);
+			} else if(!strcmp(opt, "-b")) {
+				benchmark = argv[i];
+			} else if(!strcmp(opt, "--threads")) {
+				threads = atoi(argv[i]);
+			} else if(!strcmp(opt, "--load")) {
+				loadFile = argv[i];
+			} else if(!strcmp(opt, "--save")) {
+				saveFile = argv[i];
+			} else if(!strcmp(opt, "--save-interval")) {
+				saveInterval = atof(argv[i]);
+			} else if(!strcmp(opt, "--record")) {
+				recordFile = argv[i];
+			} else if(!strcmp(opt, "--replay")) {
+				replayFile = argv[i];
+			} else if(!strcmp(opt, "--profile")) {
+				profileFile = argv[i];
+			} else if(!strcmp(opt, "--map-size")) {
+				mapSize = atoi(argv[i]);
+			} else {
+				timelimit = atof(argv[i]);
+			}
+		} else {
+			std::cerr << "Unknown parameter '" << argv[i] << "'.\n";
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if(timestep <= 0.0f) {
+		std::cerr << "The timestep must be positive.\n";
+		exit(1);
+	}
+
+	if(threads < 1) {
+		std::cerr << "The number of threads must be at least 1.\n";
+		exit(1);
+	}
+
+	if(mapSize && (mapSize < 384 || mapSize % 128)) {
+		std::cerr << "The map size must be a multiple of 128 and at least 384.\n";
+		exit(1);
+	}
+
+	if(recordFile && loadFile) {
+		// the replay must start from a newly created world
+		std::cerr << "A loaded battle can't be recorded.\n";
+		exit(1);
+	}
+
+	if(terrainCache)
+		Terrain::setCacheDirectory(Terrain::getDefaultCacheDirectory());
+
+	ThreadPool::setInstance(boost::shared_ptr<ThreadPool>(new ThreadPool(threads)));
+
+	if(benchmark) {
+		std::cout << "Seed: " << seed << "\n";
+		if(!Benchmarks::run(benchmark, seed)) {
+			std::cerr << "Unknown benchmark '" << benchmark << "'. Available benchmarks: ";
+			Benchmarks::printNames();
+			exit(1);
+		}
+		return 0;
+	}
+
+	if(replayFile)
+		return replay(replayFile);
+
+	std::ifstream loadStream;
+	if(loadFile) {
+		loadStream.open(loadFile, std::ios::binary);
+		if(!Savegame::readHeader(loadStream, arcade, skirmish, mapSize)) {
+			std::cerr << "Could not load " << loadFile << ".\n";
+			exit(1);
+		}
+	}
+
+	Scenario scenario(arcade, skirmish);
+	if(mapSize)
+		scenario.setMapSize(mapSize);
+
+	srand(seed);
+	std::cout << "Seed: " << seed << "\n";
+
+	WorldPtr world;
+	AgentDirectory agents;
+	if(loadFile) {
+		double start = Clock::getTime();
+		try {
+			world = Savegame::load(loadStream, scenario, agents);
+		} catch(std::exception& e) {
+			std::cerr << "Could not load " << loadFile << ": " << e.what() << "\n";
+			exit(1);
+		}
+		std::cout << "Loaded " << loadFile << " in " << (Clock::getTime() - start) * 1000.0 << " ms\n";
+		world->setSoldierListener(&agents);
+		SoldierAction::setAgentDirectory(&agents);
+	} else {
+		world = scenario.createWorld(seed);
+		world->setSoldierListener(&agents);
+		SoldierAction::setAgentDirectory(&agents);
+		world->create();
+	}
+
+	std::ofstream recordStream;
+	boost::shared_ptr<ReplayRecorder> recorder;
+	if(recordFile) {
+		recordStream.open(recordFile, std::ios::binary);
+		if(!recordStream) {
+			std::cerr << "Could not open " << recordFile << ".\n";
+			exit(1);
+		}
+		recorder.reset(new ReplayRecorder(recordStream, scenario, seed, world));
+		agents.setReplayRecorder(recorder.get());
+	}
+
+	if(profileFile)
+		Profiler::setInstance(boost::shared_ptr<Profiler>(new Profiler()));
+
+	unsigned int ticks = 0;
+	float nextSave = saveInterval;
+	double startTime = Clock::getTime();
+	while(world->teamWon() == -1 && ticks * timestep < timelimit) {
+		world->update(timestep);
+		agents.update(timestep);
+		if(profileFile)
+			Profiler::getInstance()->endFrame();
+		ticks++;
+		if(saveFile && saveInterval > 0.0f && ticks * timestep >= nextSave) {
+			saveGame(saveFile, scenario, *world, agents);
+			nextSave += saveInterval;
+		}
+	}
+	double wallTime = Clock::getTime() - startTime;
+
+	if(saveFile)
+		saveGame(saveFile, scenario, *world, agents);
+
+	if(recorder) {
+		agents.setReplayRecorder(nullptr);
+		recorder.reset();
+		recordStream.close();
+		std::cout << "Recorded " << recordFile << " (" << getFileSize(recordFile) << " bytes)\n";
+	}
+
+	std::cout << "Ticks: " << ticks << "\n";
+	std::cout << "Simulation time: " << ticks * timestep << " s (" << world->getCurrentTimeAsString() << ")\n";
+	std::cout << "Wall-clock time: " << wallTime << " s\n";
+	std::cout << "Ticks per second: " << (wallTime > 0.0 ? ticks / wallTime : 0.0) << "\n";
+	std::cout << "Outcome: " << outcomeToString(world->teamWon()) << "\n";
+
+	if(profileFile)
+		writeProfile(profileFile);
+
+	world->setSoldierListener(nullptr);
+	SoldierAction::setAgentDirectory(nullptr);
+
+	return 0;
+}
+
@@ -1,12 +1,17 @@
 #include <iostream>
+#include <fstream>
 
 #include <stdlib.h>
 #include <string.h>
 
-#include "Armory.h"
+#include "Scenario.h"
 #include "World.h"
+#include "Terrain.h"
 #include "Driver.h"
 #include "DebugOutput.h"
+#include "ThreadPool.h"
+#include "Replay.h"
+#include "Profiler.h"
 
 using namespace Brigades;
 using namespace Common;
@@ -35,56 +40,6 @@ bool getParameter(int argc, char** argv, int& i,
 	return false;
 }
 
-class ArcadeArmory : public Armory {
-	public:
-		ArcadeArmory();
-};
-
-class SimulationArmory : public Armory {
-	public:
-		SimulationArmory();
-};
-
-SimulationArmory::SimulationArmory()
-{
-	mAssaultRifle = boost::shared_ptr<WeaponType>(new WeaponType("Assault Rifle",
-				170.0f, 200.0f, 0.1f,
-				Math::degreesToRadians(1.0f), true));
-	mMachineGun = boost::shared_ptr<WeaponType>(new WeaponType("Machine Gun",
-				180.0f, 200.0f, 0.04f,
-				Math::degreesToRadians(2.0f), true));
-	mBazooka = boost::shared_ptr<WeaponType>(new WeaponType("Bazooka",
-				150.0f, 160.0f, 4.0f,
-				Math::degreesToRadians(0.5f), true,
-				1.0f, 1.0f, 1.0f));
-	mPistol = boost::shared_ptr<WeaponType>(new WeaponType("Pistol",
-				100.0f, 180.0f, 0.5f,
-				Math::degreesToRadians(2.0f), true));
-	mAutoCannon = boost::shared_ptr<WeaponType>(new WeaponType("Automatic Cannon",
-				200.0f, 200.0f, 0.25f,
-				Math::degreesToRadians(1.0f), false, 1.0f, 1.0f, 0.0f));
-}
-
-ArcadeArmory::ArcadeArmory()
-{
-	mAssaultRifle = boost::shared_ptr<WeaponType>(new WeaponType("Assault Rifle",
-				25.0f, 20.0f, 0.1f,
-				Math::degreesToRadians(5.0f), false));
-	mMachineGun = boost::shared_ptr<WeaponType>(new WeaponType("Machine Gun",
-				35.0f, 20.0f, 0.04f,
-				Math::degreesToRadians(5.0f), false));
-	mBazooka = boost::shared_ptr<WeaponType>(new WeaponType("Bazooka",
-				30.0f, 16.0f, 4.0f,
-				Math::degreesToRadians(5.0f), false,
-				1.0f, 1.0f, 1.0f));
-	mPistol = boost::shared_ptr<WeaponType>(new WeaponType("Pistol",
-				15.0f, 18.0f, 0.5f,
-				Math::degreesToRadians(5.0f), false));
-	mAutoCannon = boost::shared_ptr<WeaponType>(new WeaponType("Automatic Cannon",
-				40.0f, 20.0f, 0.25f,
-				Math::degreesToRadians(5.0f), false, 1.0f, 1.0f, 0.0f));
-}
-
 int main(int argc, char** argv)
 {
 	std::cout << "Brigades\n";
@@ -95,6 +50,12 @@ int main(int argc, char** argv)
 	bool arcade = false;
 	bool skirmish = false;
 
+	float tickrate = 50.0f;
+	int threads = 1;
+
+	const char* recordFile = nullptr;
+	const char* profileFile = nullptr;
+
 	int seed = time(NULL);
 
 	for(int i = 1; i < argc; i++) {
@@ -125,56 +86,91 @@ int main(int argc, char** argv)
 				exit(1);
 			}
 			seed = atoi(argv[i]);
+		} else if(!strcmp(argv[i], "--tickrate")) {
+			i++;
+			if(i == argc) {
+				std::cerr << "--tickrate requires a parameter.\n";
+				exit(1);
+			}
+			tickrate = atof(argv[i]);
+		} else if(!strcmp(argv[i], "--record")) {
+			i++;
+			if(i == argc) {
+				std::cerr << "--record requires a parameter.\n";
+				exit(1);
+			}
+			recordFile = argv[i];
+		} else if(!strcmp(argv[i], "--profile")) {
+			i++;
+			if(i == argc) {
+				std::cerr << "--profile requires a parameter.\n";
+				exit(1);
+			}
+			profileFile = argv[i];
+		} else if(!strcmp(argv[i], "--threads")) {
+			i++;
+			if(i == argc) {
+				std::cerr << "--threads requires a parameter.\n";
+				exit(1);
+			}
+			threads = atoi(argv[i]);
+			if(threads < 1) {
+				std::cerr << "The number of threads must be at least 1.\n";
+				exit(1);
+			}
 		} else {
 			std::cerr << "Unknown parameter '" << argv[i] << "'.\n";
 			exit(1);
 		}
 	}
-	float width, height, visibility, sounddistance;
-	Armory* a;
-	UnitSize u = UnitSize::Company;
-	if(arcade) {
-		a = new ArcadeArmory();
-		visibility = 30.0f;
-		sounddistance = 50.0f;
-		if(skirmish) {
-			width = 256.0f;
-			height = 256.0f;
-			u = UnitSize::Squad;
-		} else {
-			width = 512.0f;
-			height = 512.0f;
-		}
-	} else {
-		a = new SimulationArmory();
-		visibility = 200.0f;
-		sounddistance = 300.0f;
-		if(skirmish) {
-			width = 512.0f;
-			height = 512.0f;
-			u = UnitSize::Squad;
-		} else {
-			width = 1536.0f;
-			height = 1536.0f;
-		}
-	}
+	Scenario scenario(arcade, skirmish);
+	Terrain::setCacheDirectory(Terrain::getDefaultCacheDirectory());
+	ThreadPool::setInstance(boost::shared_ptr<ThreadPool>(new ThreadPool(threads)));
 
 	srand(seed);
 	std::cout << "Seed: " << seed << "\n";
 
-	WorldPtr world(new World(width, height, visibility, sounddistance, u, u == UnitSize::Company, *a));
-	DriverPtr driver(new Driver(world, observer, r));
+	WorldPtr world = scenario.createWorld(seed);
+	DriverPtr driver(new Driver(world, observer, r, tickrate));
 	if(debug)
 		DebugOutput::setInstance(driver);
 
 	InfoChannel::setInstance(driver);
 
 	world->create();
+
+	std::ofstream recordStream;
+	boost::shared_ptr<ReplayRecorder> recorder;
+	if(recordFile) {
+		recordStream.open(recordFile, std::ios::binary);
+		if(!recordStream) {
+			std::cerr << "Could not open " << recordFile << ".\n";
+			exit(1);
+		}
+		recorder.reset(new ReplayRecorder(recordStream, scenario, seed, world));
+		driver->setReplayRecorder(recorder.get());
+	}
+
+	// F9 shows the profiler
+	if(profileFile)
+		Profiler::setInstance(boost::shared_ptr<Profiler>(new Profiler()));
+
 	driver->init();
 
 	driver->run();
 
-	delete a;
+	if(recorder) {
+		driver->setReplayRecorder(nullptr);
+		std::cout << "Recorded " << recorder->getNumTicks() << " ticks to " << recordFile << "\n";
+		recorder.reset();
+	}
+
+	if(profileFile) {
+		if(Profiler::getInstance()->writeFile(profileFile))
+			std::cout << "Wrote the profile to " << profileFile << "\n";
+		else
+			std::cerr << "Could not write " << profileFile << ".\n";
+	}
 
 	return 0;
 }